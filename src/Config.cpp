@@ -65,6 +65,15 @@ std::string Config::_defaults =
   "gc=on                                          # Garbage-collect data files - DO NOT CHANGE unless you are sure\n"
   "exit.on.missing.db=no                          # Whether to exit if ~/.task is not found\n"
   "hooks=on                                       # Master control switch for hooks\n"
+  "hooks.persistent=                              # Hook scripts that run once per command\n"
+  "hooks.parallel=0                               # Concurrent on-launch/on-exit scripts, 0 uses all cores\n"
+  "hooks.timeout=0                                # Seconds before a hook script is stopped, 0 is no limit\n"
+  "hooks.timeout.total=0                          # Seconds for all hook scripts of a command, 0 is no limit\n"
+  "hooks.latency=off                              # Keep hook script latencies for diagnostics\n"
+  "snapshot=on                                    # Cache data files as binary snapshots\n"
+  "data.journal=off                               # Append modified tasks to data files\n"
+  "data.journal.compact=100                       # Compact data files beyond this % obsolete records\n"
+  "data.tombstones=off                            # Cancel records of tasks that move to another file\n"
   "\n"
   "# Terminal\n"
   "detection=on                                   # Detects terminal width\n"
@@ -102,10 +111,15 @@ std::string Config::_defaults =
   "recurrence.indicator=R                         # What to show as a task recurrence indicator\n"
   "recurrence.limit=1                             # Number of future recurring pending tasks\n"
   "undo.style=side                                # Undo style - can be 'side', or 'diff'\n"
+  "undo.segment.size=10000000                     # Start a new undo segment beyond this size\n"
+  "undo.retention=0                               # Days to keep old undo segments, 0 for ever\n"
+  "undo.compress=off                              # Compress old undo segments\n"
+  "undo.delta=on                                  # Record only changed attributes in undo.data\n"
   "burndown.bias=0.666                            # Weighted mean bias toward recent data\n"
   "regex=yes                                      # Assume all search/filter strings are regexes\n"
   "xterm.title=no                                 # Sets xterm title for some commands\n"
   "expressions=infix                              # Prefer infix over postfix expressions\n"
+  "filter.threads=0                               # Threads for filtering, 0 uses all cores\n"
   "dom=on                                         # Support DOM access\n"
   "json.array=off                                 # Enclose JSON output in [ ]\n"
   "abbreviation.minimum=2                         # Shortest allowed abbreviation\n"
@@ -367,6 +367,11 @@ int Context::run ()
                         timer_hooks.total ())
       << "\n";
     debug (s.str ());
+
+    // The time taken by each hook script.
+    std::vector <std::pair <std::string, unsigned long> >::const_iterator l;
+    for (l = hooks.latencies ().begin (); l != hooks.latencies ().end (); ++l)
+      debug (format ("Perf hook {1} {2}", l->first, (int) l->second));
   }
 
   catch (const std::string& message)
@@ -387,6 +392,8 @@ int Context::run ()
     rc = 3;
   }
 
+  hooks.finish ();
+
   // Dump all debug messages, controlled by rc.debug.
   if (config.getBoolean ("debug"))
   {
@@ -668,6 +675,8 @@ void Context::staticInitialization ()
     if (var->substr (0, 13) == "urgency.user." ||
         var->substr (0, 12) == "urgency.uda.")
       Task::coefficients[*var] = config.getReal (*var);
+
+  Task::compileCoefficients ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -440,6 +440,87 @@ bool DOM::get (const std::string& name, const Task& task, Variant& value)
   return this->get (name, value);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Resolves <attribute>, id and urgency references to a slot, which get can
+// then read from any task without parsing the reference again.  Returns -1
+// for other references.
+int DOM::compile (const std::string& name)
+{
+  std::map <std::string, int>::iterator known = _slot_names.find (name);
+  if (known != _slot_names.end ())
+    return known->second;
+
+  Slot slot;
+  slot.name = name;
+  slot.uda  = false;
+
+  if (name == "id")
+    slot.type = 'i';
+  else if (name == "urgency")
+    slot.type = 'u';
+  else
+  {
+    if (name.find ('.') != std::string::npos ||
+        ! context.cli.canonicalize (slot.attribute, "attribute", name))
+      return -1;
+
+    std::map <std::string, Column*>::iterator found = context.columns.find (slot.attribute);
+    if (found == context.columns.end () || ! found->second)
+      return -1;
+
+    Column* column = found->second;
+    slot.uda = column->is_uda ();
+    if (column->type () == "date")
+      slot.type = 'd';
+    else if (column->type () == "duration" || slot.attribute == "recur")
+      slot.type = 'D';
+    else if (column->type () == "numeric")
+      slot.type = 'n';
+    else
+      slot.type = 's';
+  }
+
+  _slots.push_back (slot);
+  return _slot_names[name] = _slots.size () - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads a slot from the task, with the same result as get would give for the
+// reference.  The value carries the reference as its source.
+bool DOM::get (int index, const Task& task, Variant& value) const
+{
+  if (! task.size ())
+    return false;
+
+  const Slot& slot = _slots[index];
+  switch (slot.type)
+  {
+  case 'i':
+    value = Variant (task.id);
+    break;
+
+  case 'u':
+    value = Variant (task.urgency_c ());
+    break;
+
+  default:
+    if (slot.uda && ! task.has (slot.attribute))
+      value = Variant ("''");
+    else if (slot.type == 'd')
+      value = Variant (task.get_date (slot.attribute), Variant::type_date);
+    else if (slot.type == 'D')
+      value = Variant ((time_t) Duration (task.get (slot.attribute)), Variant::type_duration);
+    else if (slot.type == 'n')
+      value = Variant (task.get_float (slot.attribute));
+    else
+      value = Variant (task.get (slot.attribute));
+    break;
+  }
+
+  value.source (slot.name);
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void DOM::set (const std::string& name, const Variant& value)
 {
@@ -28,6 +28,8 @@
 #define INCLUDED_DOM
 
 #include <string>
+#include <vector>
+#include <map>
 #include <Variant.h>
 #include <Task.h>
 #include <time.h>
@@ -41,9 +43,22 @@ public:
   const std::vector <std::string> get_references () const;
   bool get (const std::string&, Variant&);
   bool get (const std::string&, const Task&, Variant&);
+  int compile (const std::string&);
+  bool get (int, const Task&, Variant&) const;
   void set (const std::string&, const Variant&);
 
 private:
+  // A reference to an attribute of the task itself, resolved once.
+  struct Slot
+  {
+    std::string name;
+    std::string attribute;
+    char        type;       // i=id, u=urgency, d=date, D=duration, n=numeric, s=string
+    bool        uda;
+  };
+
+  std::vector <Slot> _slots;
+  std::map <std::string, int> _slot_names;
 };
 
 #endif
@@ -82,7 +82,8 @@ static void midsommar (struct tm* t)
   t->tm_isdst = -1;                       // Probably DST, but check.
 
   time_t then = mktime (t);               // Obtain the weekday of June 20th.
-  struct tm* mid = localtime (&then);
+  struct tm local;
+  struct tm* mid = localtime_r (&then, &local);
   t->tm_mday += 6 - mid->tm_wday;         // How many days after 20th.
 }
 
@@ -95,7 +96,8 @@ static void midsommarafton (struct tm* t)
   t->tm_isdst = -1;                       // Probably DST, but check.
 
   time_t then = mktime (t);               // Obtain the weekday of June 19th.
-  struct tm* mid = localtime (&then);
+  struct tm local;
+  struct tm* mid = localtime_r (&then, &local);
   t->tm_mday += 5 - mid->tm_wday;         // How many days after 19th.
 }
 
@@ -130,7 +132,8 @@ static void midsommarafton (struct tm* t)
 bool namedDates (const std::string& name, Variant& value)
 {
   time_t now = time (NULL);
-  struct tm* t = localtime (&now);
+  struct tm local;
+  struct tm* t = localtime_r (&now, &local);
   int i;
 
   // Dynamics.
@@ -451,7 +454,7 @@ bool namedDates (const std::string& name, Variant& value)
     // If the result is earlier this year, then recalc for next year.
     if (value < valueNow)
     {
-      t = localtime (&now);
+      t = localtime_r (&now, &local);
       t->tm_year++;
       easter (t);
     }
@@ -473,7 +476,7 @@ bool namedDates (const std::string& name, Variant& value)
     // If the result is earlier this year, then recalc for next year.
     if (value < valueNow)
     {
-      t = localtime (&now);
+      t = localtime_r (&now, &local);
       t->tm_year++;
       midsommar (t);
     }
@@ -490,7 +493,7 @@ bool namedDates (const std::string& name, Variant& value)
     // If the result is earlier this year, then recalc for next year.
     if (value < valueNow)
     {
-      t = localtime (&now);
+      t = localtime_r (&now, &local);
       t->tm_year++;
       midsommarafton (t);
     }
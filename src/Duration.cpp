@@ -296,17 +296,25 @@ std::string Duration::formatISO () const
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+static std::vector <std::string> durationUnits ()
+{
+  std::vector <std::string> units;
+  for (unsigned int i = 0; i < NUM_DURATIONS; i++)
+    units.push_back (durations[i].unit);
+
+  return units;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool Duration::parse (const std::string& input, std::string::size_type& start)
 {
   std::string::size_type original_start = start;
   Nibbler n (input.substr (start));
 
-  // Static and so preserved between calls.
-  static std::vector <std::string> units;
-  if (units.size () == 0)
-    for (unsigned int i = 0; i < NUM_DURATIONS; i++)
-      units.push_back (durations[i].unit);
+  // Static and so preserved between calls.  Initialized once, which is safe
+  // when filters are evaluated in several threads.
+  static const std::vector <std::string> units = durationUnits ();
 
   std::string number;
   std::string unit;
@@ -35,7 +35,7 @@
 #include <i18n.h>
 
 extern Context context;
-extern Task& contextTask;
+extern thread_local const Task* contextTask;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Supported operators, borrowed from C++, particularly the precedence.
@@ -104,8 +104,11 @@ static bool namedConstants (const std::string& name, Variant& value)
 
 ////////////////////////////////////////////////////////////////////////////////
 Eval::Eval ()
-: _ambiguity (true)
+: _resolve (NULL)
+, _fetch (NULL)
+, _ambiguity (true)
 , _debug (false)
+, _known (NULL)
 {
   addSource (namedConstants);
 }
@@ -121,86 +124,169 @@ void Eval::addSource (bool (*source)(const std::string&, Variant&))
   _sources.push_back (source);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// A resolver maps an identifier to a slot when the expression is compiled, and
+// the fetch function reads that slot on every evaluation, which avoids looking
+// up the identifier by name each time.  Instead of a slot, the resolver may
+// return Eval::constant for identifiers that can be resolved once through the
+// sources, or Eval::variable for those that cannot.
+void Eval::addResolver (
+  int (*resolve)(const std::string&),
+  bool (*fetch)(int, Variant&))
+{
+  _resolve = resolve;
+  _fetch   = fetch;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void Eval::evaluateInfixExpression (const std::string& e, Variant& v) const
 {
   // Reduce e to a vector of tokens.
-  Lexer l (e);
-  l.ambiguity (_ambiguity);
   std::vector <std::pair <std::string, Lexer::Type> > tokens;
-  std::string token;
-  Lexer::Type type;
-  while (l.token (token, type))
-    tokens.push_back (std::pair <std::string, Lexer::Type> (token, type));
+  tokenize (e, tokens);
 
   // Parse for syntax checking and operator replacement.
   if (_debug)
-    context.debug ("[1;37;42mFILTER[0m Infix        " + dump (tokens));
+    context.debug ("[1;37;42mFILTER[0m Infix        " + dump (tokens));
   infixParse (tokens);
   if (_debug)
-    context.debug ("[1;37;42mFILTER[0m Infix parsed " + dump (tokens));
+    context.debug ("[1;37;42mFILTER[0m Infix parsed " + dump (tokens));
 
   // Convert infix --> postfix.
   infixToPostfix (tokens);
   if (_debug)
-    context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (tokens));
+    context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (tokens));
 
-  // Call the postfix evaluator.
-  evaluatePostfixStack (tokens, v);
+  // Compile and run.
+  Program program;
+  compile (tokens, program);
+  evaluateProgram (program, v);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void Eval::evaluatePostfixExpression (const std::string& e, Variant& v) const
 {
   // Reduce e to a vector of tokens.
-  Lexer l (e);
-  l.ambiguity (_ambiguity);
   std::vector <std::pair <std::string, Lexer::Type> > tokens;
-  std::string token;
-  Lexer::Type type;
-  while (l.token (token, type))
-    tokens.push_back (std::pair <std::string, Lexer::Type> (token, type));
+  tokenize (e, tokens);
 
   if (_debug)
-    context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (tokens));
+    context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (tokens));
 
-  // Call the postfix evaluator.
-  evaluatePostfixStack (tokens, v);
+  // Compile and run.
+  Program program;
+  compile (tokens, program);
+  evaluateProgram (program, v);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void Eval::compileExpression (const std::string& e)
 {
   // Reduce e to a vector of tokens.
-  Lexer l (e);
-  l.ambiguity (_ambiguity);
-  std::string token;
-  Lexer::Type type;
-  while (l.token (token, type))
+  std::vector <std::pair <std::string, Lexer::Type> > tokens;
+  tokenize (e, tokens);
+  if (_debug)
   {
-    if (_debug)
-      context.debug ("Lexer '" + token + "' " + Lexer::typeToString (type));
-    _compiled.push_back (std::pair <std::string, Lexer::Type> (token, type));
+    std::vector <std::pair <std::string, Lexer::Type> >::iterator token;
+    for (token = tokens.begin (); token != tokens.end (); ++token)
+      context.debug ("Lexer '" + token->first + "' " + Lexer::typeToString (token->second));
   }
 
   // Parse for syntax checking and operator replacement.
   if (_debug)
-    context.debug ("[1;37;42mFILTER[0m Infix        " + dump (_compiled));
-  infixParse (_compiled);
+    context.debug ("[1;37;42mFILTER[0m Infix        " + dump (tokens));
+  infixParse (tokens);
   if (_debug)
-    context.debug ("[1;37;42mFILTER[0m Infix parsed " + dump (_compiled));
+    context.debug ("[1;37;42mFILTER[0m Infix parsed " + dump (tokens));
 
   // Convert infix --> postfix.
-  infixToPostfix (_compiled);
+  infixToPostfix (tokens);
+  if (_debug)
+    context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (tokens));
+
+  // Convert postfix --> bytecode.
+  compile (tokens, _program);
+  _known = NULL;
   if (_debug)
-    context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (_compiled));
+    context.debug ("[1;37;42mFILTER[0m Bytecode     " + dump (_program));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Eval::evaluateCompiledExpression (Variant& v) const
+{
+  evaluateProgram (_program, v);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void Eval::evaluateCompiledExpression (Variant& v)
+// Decides which instructions of the compiled expression are unknown to the
+// 'known' function.  The decisions only depend on the names, so they are made
+// once, and evaluatePartialExpression with the same function then leaves the
+// Eval unchanged.
+void Eval::preparePartialExpression (bool (*known)(const std::string&))
 {
-  // Call the postfix evaluator.
-  evaluatePostfixStack (_compiled, v);
+  _known = known;
+  _unknown.assign (_program.code.size (), false);
+  for (unsigned int n = 0; n < _program.code.size (); ++n)
+  {
+    const Instruction& i = _program.code[n];
+    if (i.op == op_slot       ||
+        i.op == op_identifier ||
+        (i.op == op_literal && i.name != ""))
+    {
+      _unknown[n] = ! known (i.name);
+    }
+    else if ((i.op == op_hastag || i.op == op_notag) &&
+             i.right != -1)
+    {
+      std::string tag = _program.literals[i.right];
+      Lexer::dequote (tag);
+      _unknown[n] = ! known ("tags." + tag);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluates the compiled expression when only some identifiers can be
+// resolved, as decided by the 'known' function.  Logic is three-valued:
+// unknown operands make the result unknown, unless 'and' or 'or' are decided
+// by the other operand.  Returns whether the result is known.  Tag operators
+// consult 'known' for "tags.<tag>".
+bool Eval::evaluatePartialExpression (Variant& v, bool (*known)(const std::string&))
+{
+  if (known != _known)
+    preparePartialExpression (known);
+
+  bool decided;
+  evaluateProgram (_program, v, known, &_unknown, &decided);
+  return decided;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Whether the compiled expression may be evaluated by several threads at once.
+// Identifiers are resolved through the sources, and tags that are not literals
+// are looked up through the 'known' function, neither of which are safe to
+// share.  Partial evaluation must have been prepared.
+bool Eval::reentrant () const
+{
+  std::vector <Instruction>::const_iterator i;
+  for (i = _program.code.begin (); i != _program.code.end (); ++i)
+    if (i->op == op_identifier ||
+        ((i->op == op_hastag || i->op == op_notag) && i->right == -1))
+      return false;
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Whether the compiled expression reads the given resolver slot.
+bool Eval::reads (int slot) const
+{
+  std::vector <Instruction>::const_iterator i;
+  for (i = _program.code.begin (); i != _program.code.end (); ++i)
+    if (i->op == op_slot && i->arg == slot)
+      return true;
+
+  return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -235,101 +321,118 @@ void Eval::getBinaryOperators (std::vector <std::string>& all)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void Eval::evaluatePostfixStack (
+void Eval::tokenize (
+  const std::string& e,
+  std::vector <std::pair <std::string, Lexer::Type> >& tokens) const
+{
+  Lexer l (e);
+  l.ambiguity (_ambiguity);
+  std::string token;
+  Lexer::Type type;
+  while (l.token (token, type))
+    tokens.push_back (std::pair <std::string, Lexer::Type> (token, type));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Converts postfix tokens to bytecode.  Literals are cast once here, instead
+// of on every evaluation, and identifiers are resolved as far as the resolver
+// allows, so debug output for literals appears here too.  Errors in the expression are left for evaluation to report.
+void Eval::compile (
   const std::vector <std::pair <std::string, Lexer::Type> >& tokens,
-  Variant& result) const
+  Program& program) const
 {
-  if (tokens.size () == 0)
-    throw std::string (STRING_EVAL_NO_EXPRESSION);
+  program.code.clear ();
+  program.literals.clear ();
+  program.dates.clear ();
+  program.durations.clear ();
+  program.patterns.clear ();
 
-  // This is stack used by the postfix evaluator.
-  std::vector <Variant> values;
+  // Mirrors the evaluation stack, holding the literal index of each value,
+  // or -1 for computed values.
+  std::vector <int> operands;
 
   std::vector <std::pair <std::string, Lexer::Type> >::const_iterator token;
   for (token = tokens.begin (); token != tokens.end (); ++token)
   {
-    // Unary operators.
-    if (token->second == Lexer::Type::op &&
-        token->first == "!")
-    {
-      if (values.size () < 1)
-        throw std::string (STRING_EVAL_NO_EVAL);
+    Instruction i;
+    i.op    = op_literal;
+    i.arg   = -1;
+    i.left  = -1;
+    i.right = -1;
 
-      Variant right = values.back ();
-      values.pop_back ();
-      Variant result = ! right;
-      values.push_back (result);
-      if (_debug)
-        context.debug (format ("Eval {1} ↓'{2}' → ↑'{3}'", token->first, (std::string) right, (std::string) result));
-    }
-    else if (token->second == Lexer::Type::op &&
-             token->first == "_neg_")
+    if (token->second == Lexer::Type::op)
     {
-      if (values.size () < 1)
-        throw std::string (STRING_EVAL_NO_EVAL);
+      i.op   = identifyOpcode (token->first);
+      i.name = token->first;
 
-      Variant right = values.back ();
-      values.pop_back ();
+      if (i.op == op_pos)
+      {
+        // NOP, the operand stays on the stack.
+      }
+      else if (i.op == op_not ||
+               i.op == op_neg)
+      {
+        if (operands.size ())
+          operands.pop_back ();
+        operands.push_back (-1);
+      }
+      else
+      {
+        if (operands.size ())
+        {
+          i.right = operands.back ();
+          operands.pop_back ();
+        }
 
-      Variant result (0);
-      result -= right;
-      values.push_back (result);
+        if (operands.size ())
+        {
+          i.left = operands.back ();
+          operands.pop_back ();
+        }
 
-      if (_debug)
-        context.debug (format ("Eval {1} ↓'{2}' → ↑'{3}'", token->first, (std::string) right, (std::string) result));
-    }
-    else if (token->second == Lexer::Type::op &&
-             token->first == "_pos_")
-    {
-      // The _pos_ operator is a NOP.
-      if (_debug)
-        context.debug (format ("[{1}] eval op {2} NOP", values.size (), token->first));
-    }
+        operands.push_back (-1);
 
-    // Binary operators.
-    else if (token->second == Lexer::Type::op)
-    {
-      if (values.size () < 2)
-        throw std::string (STRING_EVAL_NO_EVAL);
-
-      Variant right = values.back ();
-      values.pop_back ();
-
-      Variant left = values.back ();
-      values.pop_back ();
-
-      // Ordering these by anticipation frequency of use is a good idea.
-      Variant result;
-           if (token->first == "and")      result = left && right;
-      else if (token->first == "or")       result = left || right;
-      else if (token->first == "&&")       result = left && right;
-      else if (token->first == "||")       result = left || right;
-      else if (token->first == "<")        result = left < right;
-      else if (token->first == "<=")       result = left <= right;
-      else if (token->first == ">")        result = left > right;
-      else if (token->first == ">=")       result = left >= right;
-      else if (token->first == "==")       result = left.operator== (right);
-      else if (token->first == "!==")      result = left.operator!= (right);
-      else if (token->first == "=")        result = left.operator_partial (right);
-      else if (token->first == "!=")       result = left.operator_nopartial (right);
-      else if (token->first == "+")        result = left + right;
-      else if (token->first == "-")        result = left - right;
-      else if (token->first == "*")        result = left * right;
-      else if (token->first == "/")        result = left / right;
-      else if (token->first == "^")        result = left ^ right;
-      else if (token->first == "%")        result = left % right;
-      else if (token->first == "xor")      result = left.operator_xor (right);
-      else if (token->first == "~")        result = left.operator_match (right, contextTask);
-      else if (token->first == "!~")       result = left.operator_nomatch (right, contextTask);
-      else if (token->first == "_hastag_") result = left.operator_hastag (right, contextTask);
-      else if (token->first == "_notag_")  result = left.operator_notag (right, contextTask);
-      else
-        throw format (STRING_EVAL_UNSUPPORTED, token->first);
+        switch (i.op)
+        {
+        case op_lt:
+        case op_lte:
+        case op_gt:
+        case op_gte:
+        case op_equal:
+        case op_inequal:
+        case op_partial:
+        case op_nopartial:
+          precast (program, i.left);
+          precast (program, i.right);
+          break;
 
-      values.push_back (result);
+        case op_match:
+        case op_nomatch:
+          // A constant pattern is compiled once, here.  The RX is held by
+          // pointer because a copy discards the compiled pattern, and would
+          // be compiled again during evaluation.  An invalid pattern is left
+          // for evaluation to report.
+          if (i.right != -1 && Variant::searchUsingRegex)
+          {
+            try
+            {
+              Variant right (program.literals[i.right]);
+              right.cast (Variant::type_string);
+              std::string pattern = right;
+              Lexer::dequote (pattern);
+              program.patterns.push_back (std::unique_ptr <RX> (new RX (pattern, Variant::searchCaseSensitive)));
+              i.arg = program.patterns.size () - 1;
+            }
+            catch (...)
+            {
+            }
+          }
+          break;
 
-      if (_debug)
-        context.debug (format ("Eval ↓'{1}' {2} ↓'{3}' → ↑'{4}'", (std::string) left, token->first, (std::string) right, (std::string) result));
+        default:
+          break;
+        }
+      }
     }
 
     // Literals and identifiers.
@@ -353,35 +456,9 @@ void Eval::evaluatePostfixStack (
         }
         break;
 
-
-      case Lexer::Type::op:
-        throw std::string (STRING_EVAL_OP_EXPECTED);
-        break;
-
       case Lexer::Type::dom:
       case Lexer::Type::identifier:
-        {
-          bool found = false;
-          std::vector <bool (*)(const std::string&, Variant&)>::const_iterator source;
-          for (source = _sources.begin (); source != _sources.end (); ++source)
-          {
-            if ((*source) (token->first, v))
-            {
-              if (_debug)
-                context.debug (format ("Eval identifier source '{1}' → ↑'{2}'", token->first, (std::string) v));
-              found = true;
-              break;
-            }
-          }
-
-          // An identifier that fails lookup is a string.
-          if (!found)
-          {
-            v.cast (Variant::type_string);
-            if (_debug)
-              context.debug (format ("Eval identifier source failed '{1}'", token->first));
-          }
-        }
+        compileIdentifier (token->first, i, program);
         break;
 
       case Lexer::Type::date:
@@ -417,7 +494,310 @@ void Eval::evaluatePostfixStack (
         break;
       }
 
-      values.push_back (v);
+      if (i.op == op_literal && i.arg == -1)
+      {
+        program.literals.push_back (v);
+        i.arg = program.literals.size () - 1;
+      }
+
+      operands.push_back (i.op == op_literal ? i.arg : -1);
+    }
+
+    program.code.push_back (i);
+  }
+
+  program.dates.resize (program.literals.size ());
+  program.durations.resize (program.literals.size ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Identifiers become slots when the resolver supports them, and literals when
+// they do not depend on what is evaluated.  Everything else is looked up by
+// name during evaluation.
+void Eval::compileIdentifier (
+  const std::string& name,
+  Instruction& i,
+  Program& program) const
+{
+  i.name = name;
+
+  int slot = _resolve ? _resolve (name) : variable;
+  if (slot >= 0)
+  {
+    i.op  = op_slot;
+    i.arg = slot;
+  }
+  else if (slot == constant)
+  {
+    // A source that fails now may succeed later, so the lookup is deferred.
+    try
+    {
+      Variant v;
+      lookup (name, v);
+      program.literals.push_back (v);
+      i.op  = op_literal;
+      i.arg = program.literals.size () - 1;
+    }
+    catch (...)
+    {
+      i.op = op_identifier;
+    }
+  }
+  else
+    i.op = op_identifier;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Comparing a string with a date or duration casts the string.  For a
+// literal, that cast is done here, once.  Casts that fail, or that yield a
+// trivial value, are left to the comparison.
+void Eval::precast (Program& program, int literal) const
+{
+  if (literal == -1)
+    return;
+
+  Variant& v = program.literals[literal];
+  if (v.type () != Variant::type_string)
+    return;
+
+  std::string text = v;
+  Lexer::dequote (text);
+  if (text == "")
+    return;
+
+  program.dates.resize (program.literals.size ());
+  program.durations.resize (program.literals.size ());
+
+  try
+  {
+    Variant date (v);
+    date.cast (Variant::type_date);
+    if (! date.trivial ())
+      program.dates[literal] = date;
+  }
+  catch (...)
+  {
+  }
+
+  try
+  {
+    Variant duration (v);
+    duration.cast (Variant::type_duration);
+    if (! duration.trivial ())
+      program.durations[literal] = duration;
+  }
+  catch (...)
+  {
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Resolves an identifier through the sources.  An identifier that fails
+// lookup is a string.
+void Eval::lookup (const std::string& name, Variant& v) const
+{
+  std::vector <bool (*)(const std::string&, Variant&)>::const_iterator source;
+  for (source = _sources.begin (); source != _sources.end (); ++source)
+  {
+    if ((*source) (name, v))
+    {
+      if (_debug)
+        context.debug (format ("Eval identifier source '{1}' → ↑'{2}'", name, (std::string) v));
+      return;
+    }
+  }
+
+  v = Variant (name);
+  if (_debug)
+    context.debug (format ("Eval identifier source failed '{1}'", name));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs the bytecode.  For partial evaluation, 'known' is given along with the
+// per-instruction unknown flags, and a parallel stack tracks which values are
+// unknown.  Unknown identifiers are not resolved at all.
+void Eval::evaluateProgram (
+  const Program& program,
+  Variant& result,
+  bool (*known)(const std::string&) /* = NULL */,
+  const std::vector <bool>* unknowns /* = NULL */,
+  bool* decided /* = NULL */) const
+{
+  if (program.code.size () == 0)
+    throw std::string (STRING_EVAL_NO_EXPRESSION);
+
+  std::vector <Variant> values;
+  std::vector <bool> unknown;
+  values.reserve (program.code.size ());
+
+  for (unsigned int n = 0; n < program.code.size (); ++n)
+  {
+    const Instruction& i = program.code[n];
+    switch (i.op)
+    {
+    case op_literal:
+    case op_slot:
+    case op_identifier:
+      if (known)
+      {
+        unknown.push_back ((*unknowns)[n]);
+        if ((*unknowns)[n])
+        {
+          values.push_back (Variant (i.name));
+          break;
+        }
+      }
+
+      if (i.op == op_literal)
+        values.push_back (program.literals[i.arg]);
+      else
+      {
+        values.push_back (Variant ());
+        if (i.op == op_identifier ||
+            ! _fetch (i.arg, values.back ()))
+          lookup (i.name, values.back ());
+        else if (_debug)
+          context.debug (format ("Eval identifier slot '{1}' → ↑'{2}'", i.name, (std::string) values.back ()));
+      }
+      break;
+
+    case op_pos:
+      if (_debug)
+        context.debug (format ("[{1}] eval op {2} NOP", values.size (), i.name));
+      break;
+
+    // Unary operators.  The unknown flag of the operand carries over.
+    case op_not:
+    case op_neg:
+      {
+        if (values.size () < 1)
+          throw std::string (STRING_EVAL_NO_EVAL);
+
+        Variant right = values.back ();
+        values.pop_back ();
+
+        Variant result (0);
+        if (i.op == op_not)
+          result = ! right;
+        else
+          result -= right;
+
+        values.push_back (result);
+        if (_debug)
+          context.debug (format ("Eval {1} ↓'{2}' → ↑'{3}'", i.name, (std::string) right, (std::string) result));
+      }
+      break;
+
+    // Binary operators.
+    default:
+      {
+        if (values.size () < 2)
+          throw std::string (STRING_EVAL_NO_EVAL);
+
+        Variant right = values.back ();
+        values.pop_back ();
+
+        Variant left = values.back ();
+        values.pop_back ();
+
+        bool right_unknown = false;
+        bool left_unknown  = false;
+        if (known)
+        {
+          right_unknown = unknown.back ();
+          unknown.pop_back ();
+          left_unknown = unknown.back ();
+          unknown.pop_back ();
+        }
+
+        // Substitute pre-cast literals.
+        if (i.right != -1 && ! right_unknown)
+        {
+          int type = left.type ();
+          if (type == Variant::type_date &&
+              program.dates[i.right].type () == Variant::type_date)
+            right = program.dates[i.right];
+          else if (type == Variant::type_duration &&
+                   program.durations[i.right].type () == Variant::type_duration)
+            right = program.durations[i.right];
+        }
+
+        if (i.left != -1 && ! left_unknown)
+        {
+          int type = right.type ();
+          if (type == Variant::type_date &&
+              program.dates[i.left].type () == Variant::type_date)
+            left = program.dates[i.left];
+          else if (type == Variant::type_duration &&
+                   program.durations[i.left].type () == Variant::type_duration)
+            left = program.durations[i.left];
+        }
+
+        RX* pattern = i.arg != -1 ? program.patterns[i.arg].get () : NULL;
+
+        Variant result;
+        switch (i.op)
+        {
+        case op_and:         result = left && right;                                    break;
+        case op_or:          result = left || right;                                    break;
+        case op_lt:          result = left < right;                                     break;
+        case op_lte:         result = left <= right;                                    break;
+        case op_gt:          result = left > right;                                     break;
+        case op_gte:         result = left >= right;                                    break;
+        case op_equal:       result = left.operator== (right);                          break;
+        case op_inequal:     result = left.operator!= (right);                          break;
+        case op_partial:     result = left.operator_partial (right);                    break;
+        case op_nopartial:   result = left.operator_nopartial (right);                  break;
+        case op_add:         result = left + right;                                     break;
+        case op_subtract:    result = left - right;                                     break;
+        case op_multiply:    result = left * right;                                     break;
+        case op_divide:      result = left / right;                                     break;
+        case op_exponent:    result = left ^ right;                                     break;
+        case op_modulo:      result = left % right;                                     break;
+        case op_xor:         result = left.operator_xor (right);                        break;
+        case op_match:       result = left.operator_match (right, *contextTask, pattern);   break;
+        case op_nomatch:     result = left.operator_nomatch (right, *contextTask, pattern); break;
+        case op_hastag:      result = left.operator_hastag (right, *contextTask);        break;
+        case op_notag:       result = left.operator_notag (right, *contextTask);         break;
+        default:
+          throw format (STRING_EVAL_UNSUPPORTED, i.name);
+        }
+
+        values.push_back (result);
+
+        if (known)
+        {
+          bool undecided = left_unknown || right_unknown;
+          if (undecided &&
+              i.op == op_and)
+            undecided = (left_unknown  || left.get_bool ()) &&
+                        (right_unknown || right.get_bool ());
+
+          else if (undecided &&
+                   i.op == op_or)
+            undecided = (left_unknown  || ! left.get_bool ()) &&
+                        (right_unknown || ! right.get_bool ());
+
+          else if (i.op == op_hastag ||
+                   i.op == op_notag)
+          {
+            if (i.right != -1)
+              undecided = undecided || (*unknowns)[n];
+            else
+            {
+              std::string tag = right;
+              Lexer::dequote (tag);
+              undecided = undecided || ! known ("tags." + tag);
+            }
+          }
+
+          unknown.push_back (undecided);
+        }
+
+        if (_debug)
+          context.debug (format ("Eval ↓'{1}' {2} ↓'{3}' → ↑'{4}'", (std::string) left, i.name, (std::string) right, (std::string) result));
+      }
+      break;
     }
   }
 
@@ -427,6 +807,8 @@ void Eval::evaluatePostfixStack (
     throw std::string (STRING_EVAL_NO_EVAL);
 
   result = values[0];
+  if (decided)
+    *decided = ! unknown.size () || ! unknown[0];
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -864,6 +1246,40 @@ bool Eval::identifyOperator (
   return false;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+Eval::opcode Eval::identifyOpcode (const std::string& op) const
+{
+  // Ordering these by anticipation frequency of use is a good idea.
+       if (op == "and")      return op_and;
+  else if (op == "or")       return op_or;
+  else if (op == "&&")       return op_and;
+  else if (op == "||")       return op_or;
+  else if (op == "<")        return op_lt;
+  else if (op == "<=")       return op_lte;
+  else if (op == ">")        return op_gt;
+  else if (op == ">=")       return op_gte;
+  else if (op == "==")       return op_equal;
+  else if (op == "!==")      return op_inequal;
+  else if (op == "=")        return op_partial;
+  else if (op == "!=")       return op_nopartial;
+  else if (op == "+")        return op_add;
+  else if (op == "-")        return op_subtract;
+  else if (op == "*")        return op_multiply;
+  else if (op == "/")        return op_divide;
+  else if (op == "^")        return op_exponent;
+  else if (op == "%")        return op_modulo;
+  else if (op == "xor")      return op_xor;
+  else if (op == "~")        return op_match;
+  else if (op == "!~")       return op_nomatch;
+  else if (op == "_hastag_") return op_hastag;
+  else if (op == "_notag_")  return op_notag;
+  else if (op == "!")        return op_not;
+  else if (op == "_neg_")    return op_neg;
+  else if (op == "_pos_")    return op_pos;
+
+  return op_unsupported;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::string Eval::dump (
   std::vector <std::pair <std::string, Lexer::Type> >& tokens) const
@@ -899,4 +1315,38 @@ std::string Eval::dump (
 }
 
 ////////////////////////////////////////////////////////////////////////////////
+std::string Eval::dump (const Program& program) const
+{
+  Color op_color ("gray14 on gray6");
+  Color literal_color ("rgb550 on gray6");
+  Color slot_color ("rgb045 on gray6");
+  Color identifier_color ("rgb035 on gray6");
+
+  std::string output;
+  std::vector <Instruction>::const_iterator i;
+  for (i = program.code.begin (); i != program.code.end (); ++i)
+  {
+    if (i != program.code.begin ())
+      output += ' ';
 
+    if (i->op == op_literal)
+    {
+      std::string text = "literal:" + (std::string) program.literals[i->arg];
+      if (program.dates[i->arg].type () == Variant::type_date)
+        text += "|date";
+      if (program.durations[i->arg].type () == Variant::type_duration)
+        text += "|duration";
+      output += literal_color.colorize (text);
+    }
+    else if (i->op == op_slot)
+      output += slot_color.colorize (format ("slot{1}:{2}", i->arg, i->name));
+    else if (i->op == op_identifier)
+      output += identifier_color.colorize ("lookup:" + i->name);
+    else
+      output += op_color.colorize (i->arg != -1 ? i->name + "|regex" : i->name);
+  }
+
+  return output;
+}
+
+////////////////////////////////////////////////////////////////////////////////
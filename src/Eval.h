@@ -29,12 +29,18 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <Lexer.h>
 #include <Variant.h>
+#include <RX.h>
 
 class Eval
 {
 public:
+  // Identifier classes a resolver returns instead of a slot.
+  static const int constant = -1;  // Resolved once, through the sources.
+  static const int variable = -2;  // Resolved through the sources every time.
+
   Eval ();
   virtual ~Eval ();
   Eval (const Eval&);            // Not implemented.
@@ -42,10 +48,15 @@ public:
   bool operator== (const Eval&); // Not implemented.
 
   void addSource (bool (*fn)(const std::string&, Variant&));
+  void addResolver (int (*)(const std::string&), bool (*)(int, Variant&));
   void evaluateInfixExpression (const std::string&, Variant&) const;
   void evaluatePostfixExpression (const std::string&, Variant&) const;
   void compileExpression (const std::string&);
-  void evaluateCompiledExpression (Variant&);
+  void evaluateCompiledExpression (Variant&) const;
+  void preparePartialExpression (bool (*)(const std::string&));
+  bool evaluatePartialExpression (Variant&, bool (*)(const std::string&));
+  bool reentrant () const;
+  bool reads (int) const;
   void ambiguity (bool);
   void debug (bool);
 
@@ -53,7 +64,41 @@ public:
   static void getBinaryOperators (std::vector <std::string>&);
 
 private:
-  void evaluatePostfixStack (const std::vector <std::pair <std::string, Lexer::Type> >&, Variant&) const;
+  enum opcode {op_literal, op_slot, op_identifier, op_pos, op_not, op_neg,
+               op_and, op_or, op_xor, op_lt, op_lte, op_gt, op_gte,
+               op_equal, op_inequal, op_partial, op_nopartial,
+               op_add, op_subtract, op_multiply, op_divide, op_exponent,
+               op_modulo, op_match, op_nomatch, op_hastag, op_notag,
+               op_unsupported};
+
+  // One bytecode instruction.  The argument is a literal, slot or pattern
+  // index, and left/right are the literal indexes of binary operands.
+  struct Instruction
+  {
+    opcode      op;
+    int         arg;
+    int         left;
+    int         right;
+    std::string name;
+  };
+
+  // Compiled expression, with literals pre-cast for date and duration
+  // comparisons, and precompiled regex patterns.
+  struct Program
+  {
+    std::vector <Instruction> code;
+    std::vector <Variant>     literals;
+    std::vector <Variant>     dates;
+    std::vector <Variant>     durations;
+    std::vector <std::unique_ptr <RX> > patterns;
+  };
+
+  void tokenize (const std::string&, std::vector <std::pair <std::string, Lexer::Type> >&) const;
+  void compile (const std::vector <std::pair <std::string, Lexer::Type> >&, Program&) const;
+  void compileIdentifier (const std::string&, Instruction&, Program&) const;
+  void precast (Program&, int) const;
+  void evaluateProgram (const Program&, Variant&, bool (*)(const std::string&) = NULL, const std::vector <bool>* = NULL, bool* = NULL) const;
+  void lookup (const std::string&, Variant&) const;
   void infixToPostfix (std::vector <std::pair <std::string, Lexer::Type> >&) const;
   void infixParse (std::vector <std::pair <std::string, Lexer::Type> >&) const;
   bool parseLogical (std::vector <std::pair <std::string, Lexer::Type> >&, unsigned int &) const;
@@ -67,18 +112,22 @@ private:
   bool parseExponent (std::vector <std::pair <std::string, Lexer::Type> >&, unsigned int &) const;
   bool parsePrimitive (std::vector <std::pair <std::string, Lexer::Type> >&, unsigned int &) const;
   bool identifyOperator (const std::string&, char&, unsigned int&, char&) const;
+  opcode identifyOpcode (const std::string&) const;
 
   std::string dump (std::vector <std::pair <std::string, Lexer::Type> >&) const;
+  std::string dump (const Program&) const;
 
 private:
   std::vector <bool (*)(const std::string&, Variant&)> _sources;
+  int (*_resolve)(const std::string&);
+  bool (*_fetch)(int, Variant&);
   bool _ambiguity;
   bool _debug;
-  std::vector <std::pair <std::string, Lexer::Type> > _compiled;
+  Program _program;
+  bool (*_known)(const std::string&);
+  std::vector <bool> _unknown;
 };
 
-
-
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
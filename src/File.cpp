@@ -26,10 +26,12 @@
 
 #include <cmake.h>
 #include <fstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #ifdef SOLARIS
-#include <fcntl.h> // for flock() replacement
 #include <string.h> // for memset()
 #else
 #include <sys/file.h>
@@ -170,6 +172,13 @@ bool File::lock ()
 
     if (retry <= 3)
     {
+      // The file may have been replaced while the lock was being acquired.
+      if (stale ())
+      {
+        close ();
+        return open () && lock ();
+      }
+
       _locked = true;
       return true;
     }
@@ -188,6 +197,14 @@ bool File::waitForLock ()
   if (_fh && _h != -1)
     if (flock (_h, LOCK_EX) == 0)
     {
+      // The file may have been replaced while waiting for the lock, in which
+      // case the lock is on the old file.
+      if (stale ())
+      {
+        close ();
+        return open () && waitForLock ();
+      }
+
       _locked = true;
       return true;
     }
@@ -289,13 +306,124 @@ void File::append (const std::vector <std::string>& lines)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void File::truncate ()
+void File::truncate (size_t size /* = 0 */)
+{
+  if (!_fh)
+    open ();
+
+  if (_fh)
+  {
+    fflush (_fh);
+    ftruncate (_h, size);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void File::flush ()
+{
+  if (_fh)
+    fflush (_fh);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Atomically replaces the contents of the file.  They are written to a sibling
+// temporary file in one write, synced, and renamed over the file, so that a
+// crash leaves either the old or the new contents, but never a partial file.
+// The file remains open, and locked if it was, as the new file.
+bool File::replace (const std::string& contents)
 {
   if (!_fh)
     open ();
 
+  // A symlink is followed, so that it is the target that is replaced.
+  std::string target = _data;
+  if (is_link ())
+  {
+    char* resolved = realpath (_data.c_str (), NULL);
+    if (! resolved)
+      return false;
+
+    target = resolved;
+    free (resolved);
+  }
+
+  struct stat s;
+  mode_t permissions = 0640;
+  if (_h != -1 && fstat (_h, &s) == 0)
+    permissions = s.st_mode & 07777;
+
+  std::string temporary = target + ".tmp";
+  int h = ::open (temporary.c_str (), O_RDWR | O_CREAT | O_TRUNC, permissions);
+  if (h == -1)
+    return false;
+
+  // The new file is locked before it is visible under the file name.
+  if (_locked)
+    flock (h, LOCK_EX);
+
+  const char* data = contents.data ();
+  size_t remaining = contents.length ();
+  while (remaining)
+  {
+    ssize_t written = ::write (h, data, remaining);
+    if (written == -1)
+    {
+      if (errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    data      += written;
+    remaining -= written;
+  }
+
+  if (remaining ||
+      fsync (h) ||
+      ::rename (temporary.c_str (), target.c_str ()))
+  {
+    ::close (h);
+    unlink (temporary.c_str ());
+    return false;
+  }
+
+  // The directory entry is synced too, to make the rename durable.
+  std::string::size_type slash = target.rfind ('/');
+  if (slash != std::string::npos)
+  {
+    int d = ::open (target.substr (0, slash + 1).c_str (), O_RDONLY);
+    if (d != -1)
+    {
+      fsync (d);
+      ::close (d);
+    }
+  }
+
+  bool locked = _locked;
+  close ();
+  _fh = fdopen (h, "r+");
   if (_fh)
-    ftruncate (_h, 0);
+  {
+    _h = h;
+    _locked = locked;
+  }
+  else
+    ::close (h);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Whether the file name no longer refers to the open file, because the file
+// was replaced.
+bool File::stale () const
+{
+  struct stat open, named;
+  return _h != -1                               &&
+         fstat (_h, &open) == 0                 &&
+         (stat (_data.c_str (), &named) != 0    ||
+          open.st_dev != named.st_dev           ||
+          open.st_ino != named.st_ino);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -63,7 +63,9 @@ public:
   void append (const std::string&);
   void append (const std::vector <std::string>&);
 
-  void truncate ();
+  void truncate (size_t size = 0);
+  void flush ();
+  bool replace (const std::string&);
 
   virtual mode_t mode ();
   virtual size_t size () const;
@@ -81,6 +83,9 @@ public:
   static bool append (const std::string&, const std::vector <std::string>&, bool addNewlines = true);
   static bool remove (const std::string&);
 
+private:
+  bool stale () const;
+
 private:
   FILE* _fh;
   int   _h;
@@ -25,26 +25,39 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <cmake.h>
+#include <map>
+#include <exception>
+#ifdef HAVE_LIBPTHREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#endif
 #include <Context.h>
 #include <Eval.h>
 #include <Variant.h>
 #include <Dates.h>
 #include <Filter.h>
+#include <Nibbler.h>
 #include <i18n.h>
 #include <text.h>
 #include <util.h>
 
 extern Context context;
 
+// Each thread evaluating a filter needs a few hundred tasks to be worthwhile.
+#define MIN_TASKS_PER_THREAD 250
+
 ////////////////////////////////////////////////////////////////////////////////
-// Const iterator that can be derefenced into a Task by domSource.
+// The task that DOM references refer to.  It is per thread, so that filters
+// can be evaluated in several threads at once.
 static Task dummy;
-Task& contextTask = dummy;
+thread_local const Task* contextTask = &dummy;
 
 ////////////////////////////////////////////////////////////////////////////////
 bool domSource (const std::string& identifier, Variant& value)
 {
-  if (context.dom.get (identifier, contextTask, value))
+  if (context.dom.get (identifier, *contextTask, value))
   {
     value.source (identifier);
     return true;
@@ -53,6 +66,340 @@ bool domSource (const std::string& identifier, Variant& value)
   return false;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Attribute references are resolved to DOM slots when the filter is compiled.
+// Other references without a '.' never resolve through domSource, and the
+// remaining sources do not depend on the task, so they are constant.
+static int domResolver (const std::string& identifier)
+{
+  int slot = context.dom.compile (identifier);
+  if (slot >= 0)
+    return slot;
+
+  if (identifier.find ('.') == std::string::npos)
+    return Eval::constant;
+
+  return Eval::variable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool domSlot (int slot, Variant& value)
+{
+  return context.dom.get (slot, *contextTask, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Decides whether an identifier can be resolved from a completed.data index
+// skeleton.  Identifiers that do not refer to the task, such as named dates,
+// are known too.
+static bool indexedIdentifier (const std::string& identifier)
+{
+  // Tag tests ask for "tags.<tag>".  Most virtual tags depend on attributes
+  // that are not indexed.
+  if (identifier.compare (0, 5, "tags.") == 0)
+    return Task::isIndexedTag (identifier.substr (5));
+
+  // Tasks in completed.data have no ID.
+  if (identifier == "id")
+    return true;
+
+  if (identifier == "urgency")
+    return false;
+
+  std::string canonical;
+  if (context.cli.canonicalize (canonical, "attribute", identifier))
+    return TF2::indexed_attribute (canonical);
+
+  // References to <id>.<attribute> or <uuid>.<attribute> may resolve to the
+  // task itself.
+  std::string::size_type dot = identifier.find ('.');
+  if (dot != std::string::npos)
+  {
+    Nibbler n (identifier.substr (0, dot));
+    int id;
+    std::string uuid;
+    if ((n.getInt (id) || n.getUUID (uuid)) && n.depleted ())
+      return false;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The decision does not depend on the task, so it is made once per identifier.
+static bool indexedSource (const std::string& identifier)
+{
+  static std::map <std::string, bool> decisions;
+
+  std::map <std::string, bool>::iterator decision = decisions.find (identifier);
+  if (decision != decisions.end ())
+    return decision->second;
+
+  return decisions[identifier] = indexedIdentifier (identifier);
+}
+
+#ifdef HAVE_LIBPTHREAD
+////////////////////////////////////////////////////////////////////////////////
+// Computes the urgency each blocking pending task inherits.
+static void prepareUrgency ()
+{
+  if (Task::urgencyInheritCoefficient == 0.0)
+    return;
+
+  const std::vector <Task>& pending = context.tdb2.pending.get_tasks ();
+  std::vector <Task>::const_iterator task;
+  for (task = pending.begin (); task != pending.end (); ++task)
+    if (task->is_blocking)
+      context.tdb2.pending.inherited_urgency (task->get_ref ("uuid"));
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluates the filter for tasks [begin, end), storing 1 for tasks that pass
+// and 0 for those that do not.  For partial evaluation of index skeletons, 2
+// is stored for undecided tasks.  Errors are stored rather than thrown, so
+// that they can be rethrown by the thread that started the evaluation.
+static void evaluateRange (
+  Eval* eval,
+  const std::vector <Task>* tasks,
+  unsigned int begin,
+  unsigned int end,
+  bool partial,
+  std::vector <char>* results,
+  std::exception_ptr* error)
+{
+  try
+  {
+    for (unsigned int i = begin; i < end; ++i)
+    {
+      // Set up context for any DOM references.
+      contextTask = &(*tasks)[i];
+
+      Variant var;
+      if (partial)
+      {
+        // A failure on incomplete data leaves the decision to the full task.
+        try
+        {
+          if (eval->evaluatePartialExpression (var, indexedSource))
+            (*results)[i] = var.get_bool () ? 1 : 0;
+          else
+            (*results)[i] = 2;
+        }
+
+        catch (...)
+        {
+          (*results)[i] = 2;
+        }
+      }
+      else
+      {
+        eval->evaluateCompiledExpression (var);
+        (*results)[i] = var.get_bool () ? 1 : 0;
+      }
+    }
+  }
+
+  catch (...)
+  {
+    *error = std::current_exception ();
+  }
+
+  contextTask = &dummy;
+}
+
+#ifdef HAVE_LIBPTHREAD
+////////////////////////////////////////////////////////////////////////////////
+// Threads that evaluate filters.  They are started when first needed and then
+// wait for work, so that the several filter passes of a command, over pending
+// and completed tasks, do not each start and join their own threads.
+class FilterPool
+{
+public:
+  FilterPool ();
+  ~FilterPool ();
+  void run (unsigned int, const std::function <void (unsigned int)>&);
+
+private:
+  void work ();
+  void take (std::unique_lock <std::mutex>&);
+
+private:
+  std::vector <std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const std::function <void (unsigned int)>* _job;
+  unsigned int _parts;
+  unsigned int _next;
+  unsigned int _remaining;
+  unsigned long _generation;
+  bool _stop;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+FilterPool::FilterPool ()
+: _job (NULL)
+, _parts (0)
+, _next (0)
+, _remaining (0)
+, _generation (0)
+, _stop (false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FilterPool::~FilterPool ()
+{
+  {
+    std::lock_guard <std::mutex> lock (_mutex);
+    _stop = true;
+  }
+
+  _wake.notify_all ();
+
+  std::vector <std::thread>::iterator thread;
+  for (thread = _threads.begin (); thread != _threads.end (); ++thread)
+    thread->join ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Calls job (part) for every part in [0, parts), spread over the calling
+// thread and parts - 1 pool threads, and returns when all parts are done.
+void FilterPool::run (
+  unsigned int parts,
+  const std::function <void (unsigned int)>& job)
+{
+  std::unique_lock <std::mutex> lock (_mutex);
+
+  while (_threads.size () < parts - 1)
+    _threads.push_back (std::thread (&FilterPool::work, this));
+
+  _job       = &job;
+  _parts     = parts;
+  _next      = 0;
+  _remaining = parts;
+  ++_generation;
+  _wake.notify_all ();
+
+  take (lock);
+  _done.wait (lock, [this] { return _remaining == 0; });
+  _job = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs parts of the current job until none are left to start.
+void FilterPool::take (std::unique_lock <std::mutex>& lock)
+{
+  while (_next < _parts)
+  {
+    unsigned int part = _next++;
+    const std::function <void (unsigned int)>& job = *_job;
+
+    lock.unlock ();
+    job (part);
+    lock.lock ();
+
+    if (--_remaining == 0)
+      _done.notify_all ();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FilterPool::work ()
+{
+  std::unique_lock <std::mutex> lock (_mutex);
+  unsigned long seen = _generation;
+  while (true)
+  {
+    _wake.wait (lock, [this, seen] { return _stop || _generation != seen; });
+    if (_stop)
+      return;
+
+    seen = _generation;
+    take (lock);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static FilterPool& filterPool ()
+{
+  static FilterPool pool;
+  return pool;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluates the filter for all tasks, see evaluateRange.  Large sets of tasks
+// are partitioned across the pool threads, unless evaluation may reach state
+// that is not safe to share, or debug output is wanted.  Results are in task
+// order either way.
+static void evaluateTasks (
+  Eval* eval,
+  const std::vector <Task>& tasks,
+  bool partial,
+  bool debug,
+  std::vector <char>& results)
+{
+  results.resize (tasks.size ());
+  if (tasks.size () == 0)
+    return;
+
+  // Nothing in the Eval changes during evaluation once partial evaluation is
+  // prepared, so it can be shared.
+  if (partial)
+    eval->preparePartialExpression (indexedSource);
+
+  unsigned int threads = 1;
+#ifdef HAVE_LIBPTHREAD
+  if (! debug && eval->reentrant ())
+  {
+    int setting = context.config.getInteger ("filter.threads");
+    threads = setting > 0 ? setting : std::thread::hardware_concurrency ();
+    threads = std::min (threads, (unsigned int) tasks.size () / MIN_TASKS_PER_THREAD);
+    threads = std::max (threads, 1u);
+  }
+#endif
+
+  std::exception_ptr error;
+  if (threads == 1)
+  {
+    eval->debug (debug);
+    evaluateRange (eval, &tasks, 0, tasks.size (), partial, &results, &error);
+    eval->debug (false);
+    if (error)
+      std::rethrow_exception (error);
+
+    return;
+  }
+
+#ifdef HAVE_LIBPTHREAD
+  // Urgency inheritance reads the pending tasks, which are loaded on demand.
+  // It also reads attributes of tasks that other threads evaluate, which are
+  // parsed on first use, so it is computed here, before the threads share
+  // those tasks.
+  context.tdb2.pending.get_tasks ();
+  if (eval->reads (context.dom.compile ("urgency")))
+    prepareUrgency ();
+
+  std::vector <std::exception_ptr> errors (threads);
+  unsigned int size = tasks.size () / threads;
+  filterPool ().run (threads, [&] (unsigned int t)
+  {
+    unsigned int begin = t * size;
+    unsigned int end   = t == threads - 1 ? tasks.size () : begin + size;
+    evaluateRange (eval, &tasks, begin, end, partial, &results, &errors[t]);
+  });
+
+  context.debug (format ("Filter evaluated {1} tasks in {2} threads", (int) tasks.size (), (int) threads));
+
+  std::vector <std::exception_ptr>::iterator e;
+  for (e = errors.begin (); e != errors.end (); ++e)
+    if (*e)
+      std::rethrow_exception (*e);
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 Filter::Filter ()
 : _startCount (0)
@@ -82,6 +429,7 @@ void Filter::subset (const std::vector <Task>& input, std::vector <Task>& output
     eval.ambiguity (false);
     eval.addSource (domSource);
     eval.addSource (namedDates);
+    eval.addResolver (domResolver, domSlot);
 
     // Debug output from Eval during compilation is useful.  During evaluation
     // it is mostly noise.
@@ -89,17 +437,11 @@ void Filter::subset (const std::vector <Task>& input, std::vector <Task>& output
     eval.compileExpression (filterExpr);
     eval.debug (false);
 
-    std::vector <Task>::const_iterator task;
-    for (task = input.begin (); task != input.end (); ++task)
-    {
-      // Set up context for any DOM references.
-      contextTask = *task;
-
-      Variant var;
-      eval.evaluateCompiledExpression (var);
-      if (var.get_bool ())
-        output.push_back (*task);
-    }
+    std::vector <char> results;
+    evaluateTasks (&eval, input, false, false, results);
+    for (unsigned int i = 0; i < input.size (); ++i)
+      if (results[i])
+        output.push_back (input[i]);
   }
   else
     output = input;
@@ -131,6 +473,7 @@ void Filter::subset (std::vector <Task>& output, bool applyContext /* = true */)
     eval.ambiguity (false);
     eval.addSource (domSource);
     eval.addSource (namedDates);
+    eval.addResolver (domResolver, domSlot);
 
     // Debug output from Eval during compilation is useful.  During evaluation
     // it is mostly noise.
@@ -139,42 +482,15 @@ void Filter::subset (std::vector <Task>& output, bool applyContext /* = true */)
     eval.debug (false);
 
     output.clear ();
-    std::vector <Task>::const_iterator task;
-
-    for (task = pending.begin (); task != pending.end (); ++task)
-    {
-      // Set up context for any DOM references.
-      contextTask = *task;
-
-      Variant var;
-      eval.debug (context.config.getInteger ("debug.parser") >= 2 ? true : false);
-      eval.evaluateCompiledExpression (var);
-      eval.debug (false);
-      if (var.get_bool ())
-        output.push_back (*task);
-    }
+    std::vector <char> results;
+    evaluateTasks (&eval, pending, false, context.config.getInteger ("debug.parser") >= 2, results);
+    for (unsigned int i = 0; i < pending.size (); ++i)
+      if (results[i])
+        output.push_back (pending[i]);
 
     shortcut = pendingOnly ();
     if (! shortcut)
-    {
-      context.timer_filter.stop ();
-      const std::vector <Task>& completed = context.tdb2.completed.get_tasks ();
-      context.timer_filter.start ();
-      _startCount += (int) completed.size ();
-
-      for (task = completed.begin (); task != completed.end (); ++task)
-      {
-        // Set up context for any DOM references.
-        contextTask = *task;
-
-        Variant var;
-        eval.debug (context.config.getInteger ("debug.parser") >= 2 ? true : false);
-        eval.evaluateCompiledExpression (var);
-        eval.debug (false);
-        if (var.get_bool ())
-          output.push_back (*task);
-      }
-    }
+      filterCompleted (&eval, output, false);
   }
   else
   {
@@ -198,6 +514,124 @@ void Filter::subset (std::vector <Task>& output, bool applyContext /* = true */)
   context.timer_filter.stop ();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Take the tasks in completed.data and append the filtered subset, returning
+// the number of tasks considered.  With 'skeletal', tasks that pass the filter
+// on indexed attributes alone may be represented by their index skeleton,
+// which only carries those attributes.
+int Filter::subsetCompleted (std::vector <Task>& output, bool skeletal /* = false */, bool applyContext /* = true */)
+{
+  context.timer_filter.start ();
+  _startCount = 0;
+  unsigned int before = output.size ();
+
+  std::string filterExpr = context.cli.getFilter (applyContext);
+  if (filterExpr.length ())
+  {
+    Eval eval;
+    eval.ambiguity (false);
+    eval.addSource (domSource);
+    eval.addSource (namedDates);
+    eval.addResolver (domResolver, domSlot);
+
+    eval.debug (context.config.getInteger ("debug.parser") >= 2 ? true : false);
+    eval.compileExpression (filterExpr);
+    eval.debug (false);
+
+    filterCompleted (&eval, output, skeletal);
+  }
+  else
+    filterCompleted (NULL, output, skeletal);
+
+  _endCount = (int) (output.size () - before);
+  context.debug (format ("Filtered {1} tasks --> {2} tasks [completed]", _startCount, _endCount));
+  context.timer_filter.stop ();
+  return _startCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Appends the tasks in completed.data that pass the compiled filter, or all of
+// them without a filter.  When the index of completed.data is available, the
+// filter is first evaluated against the index skeletons, and only records that
+// the indexed attributes cannot rule out are parsed.
+void Filter::filterCompleted (Eval* eval, std::vector <Task>& output, bool skeletal)
+{
+  TF2& completed = context.tdb2.completed;
+  bool debug = context.config.getInteger ("debug.parser") >= 2 ? true : false;
+
+  context.timer_filter.stop ();
+  bool indexed = ! completed._loaded_tasks && completed.load_index ();
+  context.timer_filter.start ();
+
+  // Tasks not yet committed are not in the index.
+  std::vector <Task> candidates;
+  if (indexed)
+  {
+    candidates = completed._tasks;
+
+    // Skeletons that pass, and records that need to be parsed.
+    const std::vector <Task>& index = completed.get_index ();
+    std::vector <Task> skeletons;
+    std::vector <unsigned int> records;
+    std::vector <char> results (index.size (), 1);
+    if (eval)
+      evaluateTasks (eval, index, true, false, results);
+
+    for (unsigned int r = 0; r < index.size (); ++r)
+    {
+      if (results[r] == 0)
+        continue;
+
+      if (results[r] == 1 && skeletal)
+        skeletons.push_back (index[r]);
+      else
+        records.push_back (r);
+    }
+
+    context.timer_filter.stop ();
+    std::vector <Task> parsed;
+    indexed = completed.get_records (records, parsed);
+    context.timer_filter.start ();
+
+    if (indexed)
+    {
+      context.debug (format ("Filter parsed {1} of {2} completed tasks using the index", (int) records.size (), (int) index.size ()));
+      _startCount += (int) (completed._tasks.size () + index.size ());
+
+      // Parsed tasks still need the full evaluation.
+      output.insert (output.end (), skeletons.begin (), skeletons.end ());
+      candidates.insert (candidates.end (), parsed.begin (), parsed.end ());
+    }
+  }
+
+  // Without a usable index, all of completed.data is loaded.
+  if (! indexed)
+  {
+    context.timer_filter.stop ();
+    const std::vector <Task>& all = completed.get_tasks ();
+    context.timer_filter.start ();
+    _startCount += (int) all.size ();
+
+    std::vector <char> results (all.size (), 1);
+    if (eval)
+      evaluateTasks (eval, all, false, debug, results);
+
+    for (unsigned int i = 0; i < all.size (); ++i)
+      if (results[i])
+        output.push_back (all[i]);
+
+    return;
+  }
+
+  std::vector <char> results (candidates.size (), 1);
+  if (eval)
+    evaluateTasks (eval, candidates, false, debug, results);
+
+  for (unsigned int i = 0; i < candidates.size (); ++i)
+    if (results[i])
+      output.push_back (candidates[i]);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // If the filter contains the restriction "status:pending", as the first filter
 // term, then completed.data does not need to be loaded.
@@ -31,6 +31,7 @@
 #include <vector>
 #include <Task.h>
 #include <Variant.h>
+#include <Eval.h>
 
 bool domSource (const std::string&, Variant&);
 
@@ -42,9 +43,13 @@ public:
 
   void subset (const std::vector <Task>&, std::vector <Task>&, bool applyContext = true);
   void subset (std::vector <Task>&, bool applyContext = true);
+  int subsetCompleted (std::vector <Task>&, bool skeletal = false, bool applyContext = true);
   bool pendingOnly ();
   void safety ();
 
+private:
+  void filterCompleted (Eval*, std::vector <Task>&, bool);
+
 private:
   int _startCount;
   int _endCount;
@@ -32,10 +32,20 @@
 #define _WITH_GETLINE
 #endif
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <cstring>
+#include <signal.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <sys/select.h>
+#ifdef HAVE_LIBPTHREAD
+#include <thread>
+#endif
 #include <Context.h>
+#include <Date.h>
 #include <JSON.h>
 #include <Hooks.h>
 #include <Timer.h>
@@ -45,22 +55,47 @@
 
 extern Context context;
 
+// The number of recent script runs kept in hooks.latency.
+#define HOOK_LATENCY_RUNS 1000
+
+// A hook script running concurrently with others.
+struct HookJob
+{
+  unsigned int   index;
+  pid_t          pid;
+  int            input;
+  int            output;
+  unsigned int   written;
+  std::string    received;
+  struct timeval start;
+  bool           exited;
+  int            status;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 Hooks::Hooks ()
 : _enabled (true)
 , _debug (0)
+, _timeout (0.0)
+, _budget (0.0)
+, _spent (0.0)
 {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 Hooks::~Hooks ()
 {
+  finish ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void Hooks::initialize ()
 {
-  _debug = context.config.getInteger ("debug.hooks");
+  _debug   = context.config.getInteger ("debug.hooks");
+  _timeout = context.config.getReal ("hooks.timeout");
+  _budget  = context.config.getReal ("hooks.timeout.total");
+
+  _has.clear ();
 
   // Scan <rc.data.location>/hooks
   Directory d (context.config.get ("data.location"));
@@ -91,6 +126,8 @@ void Hooks::initialize ()
   else if (_debug >= 1)
     context.debug ("Hook directory not readable: " + d._data);
 
+  split (_persistent, context.config.get ("hooks.persistent"), ',');
+
   _enabled = context.config.getBoolean ("hooks");
 }
 
@@ -124,20 +161,21 @@ void Hooks::onLaunch ()
   std::vector <std::string> matchingScripts = scripts ("on-launch");
   if (matchingScripts.size ())
   {
-    std::vector <std::string>::iterator script;
-    for (script = matchingScripts.begin (); script != matchingScripts.end (); ++script)
-    {
-      std::vector <std::string> input;
-      std::vector <std::string> output;
-      int status = callHookScript (*script, input, output);
+    // The scripts cannot affect each other, so they run concurrently.
+    std::vector <std::string> input;
+    std::vector <std::vector <std::string> > outputs;
+    std::vector <int> statuses;
+    callHookScripts (matchingScripts, input, outputs, statuses);
 
+    for (unsigned int i = 0; i < matchingScripts.size (); ++i)
+    {
       std::vector <std::string> outputJSON;
       std::vector <std::string> outputFeedback;
-      separateOutput (output, outputJSON, outputFeedback);
+      separateOutput (outputs[i], outputJSON, outputFeedback);
 
       assertNTasks (outputJSON, 0);
 
-      if (status == 0)
+      if (statuses[i] == 0)
       {
         std::vector <std::string>::iterator message;
         for (message = outputFeedback.begin (); message != outputFeedback.end (); ++message)
@@ -191,20 +229,21 @@ void Hooks::onExit ()
     for (t = tasks.begin (); t != tasks.end (); ++t)
       input.push_back (t->composeJSON ());
 
-    // Call the hook scripts, with the invariant input.
-    std::vector <std::string>::iterator script;
-    for (script = matchingScripts.begin (); script != matchingScripts.end (); ++script)
-    {
-      std::vector <std::string> output;
-      int status = callHookScript (*script, input, output);
+    // Call the hook scripts, with the invariant input.  The scripts cannot
+    // affect each other, so they run concurrently.
+    std::vector <std::vector <std::string> > outputs;
+    std::vector <int> statuses;
+    callHookScripts (matchingScripts, input, outputs, statuses);
 
+    for (unsigned int i = 0; i < matchingScripts.size (); ++i)
+    {
       std::vector <std::string> outputJSON;
       std::vector <std::string> outputFeedback;
-      separateOutput (output, outputJSON, outputFeedback);
+      separateOutput (outputs[i], outputJSON, outputFeedback);
 
       assertNTasks (outputJSON, 0);
 
-      if (status == 0)
+      if (statuses[i] == 0)
       {
         std::vector <std::string>::iterator message;
         for (message = outputFeedback.begin (); message != outputFeedback.end (); ++message)
@@ -240,59 +279,116 @@ void Hooks::onExit ()
 //
 void Hooks::onAdd (Task& task)
 {
-  if (! _enabled)
+  std::vector <Task> tasks (1, task);
+  onAdd (tasks, false);
+  task = tasks[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tasks added together, as by import, first go through the on-add scripts one
+// task at a time, then through the on-add-batch scripts all at once.  A task
+// added by itself, as by 'task add', does not trigger on-add-batch.
+//
+// Input (on-add-batch):
+// - line of JSON for each task added
+//
+// Output (on-add-batch):
+// - emitted JSON for each input task, in the same order, is added, if the exit
+//   code is zero, otherwise ignored.
+// - all emitted non-JSON lines are considered feedback or error messages
+//   depending on the status code.
+//
+void Hooks::onAdd (std::vector <Task>& tasks)
+{
+  onAdd (tasks, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Hooks::onAdd (std::vector <Task>& tasks, bool batch)
+{
+  if (! _enabled || ! tasks.size ())
     return;
 
   context.timer_hooks.start ();
 
   std::vector <std::string> matchingScripts = scripts ("on-add");
-  if (matchingScripts.size ())
+  std::vector <std::string> batchScripts;
+  if (batch)
+    batchScripts = scripts ("on-add-batch");
+  if (matchingScripts.size () || batchScripts.size ())
   {
-    // Convert task to a vector of strings.
+    // Convert tasks to a vector of strings.
     std::vector <std::string> input;
-    input.push_back (task.composeJSON ());
+    input.reserve (tasks.size ());
+    std::vector <Task>::iterator task;
+    for (task = tasks.begin (); task != tasks.end (); ++task)
+      input.push_back (task->composeJSON ());
 
-    // Call the hook scripts.
+    // Call the hook scripts, once per task.
     std::vector <std::string>::iterator script;
-    for (script = matchingScripts.begin (); script != matchingScripts.end (); ++script)
+    for (unsigned int i = 0; i < tasks.size (); ++i)
     {
-      std::vector <std::string> output;
-      int status = callHookScript (*script, input, output);
+      std::vector <std::string> single (1, input[i]);
+      for (script = matchingScripts.begin (); script != matchingScripts.end (); ++script)
+      {
+        callTaskScript (*script, single, single, &tasks[i], 1);
+        input[i] = single[0];
+      }
+    }
 
-      std::vector <std::string> outputJSON;
-      std::vector <std::string> outputFeedback;
-      separateOutput (output, outputJSON, outputFeedback);
+    // Call the batch hook scripts, once for all tasks.
+    for (script = batchScripts.begin (); script != batchScripts.end (); ++script)
+      callTaskScript (*script, input, input, &tasks[0], tasks.size ());
 
-      if (status == 0)
-      {
-        assertNTasks    (outputJSON, 1);
-        assertValidJSON (outputJSON);
-        assertSameTask  (outputJSON, task);
+    // Transfer the modified tasks back to the original tasks.
+    for (unsigned int i = 0; i < tasks.size (); ++i)
+      tasks[i] = Task (input[i]);
+  }
 
-        // Propagate forward to the next script.
-        input[0] = outputJSON[0];
+  context.timer_hooks.stop ();
+}
 
-        std::vector <std::string>::iterator message;
-        for (message = outputFeedback.begin (); message != outputFeedback.end (); ++message)
-          context.footnote (*message);
-      }
-      else
-      {
-        assertFeedback (outputFeedback);
+////////////////////////////////////////////////////////////////////////////////
+// Calls a script with the given lines of input, and replaces the output with
+// the accepted line of JSON for each of the tasks.
+void Hooks::callTaskScript (
+  const std::string& script,
+  const std::vector <std::string>& input,
+  std::vector <std::string>& accepted,
+  const Task* tasks,
+  unsigned int count)
+{
+  std::vector <std::string> output;
+  int status = callHookScript (script, input, output);
 
-        std::vector <std::string>::iterator message;
-        for (message = outputFeedback.begin (); message != outputFeedback.end (); ++message)
-          context.error (*message);
+  std::vector <std::string> outputJSON;
+  std::vector <std::string> outputFeedback;
+  separateOutput (output, outputJSON, outputFeedback);
 
-        throw 0;  // This is how hooks silently terminate processing.
-      }
-    }
+  if (status == 0)
+  {
+    assertNTasks    (outputJSON, count);
+    assertValidJSON (outputJSON);
+    for (unsigned int i = 0; i < outputJSON.size (); ++i)
+      assertSameTask (std::vector <std::string> (1, outputJSON[i]), tasks[i]);
 
-    // Transfer the modified task back to the original task.
-    task = Task (input[0]);
+    // Propagate forward to the next script.
+    accepted = outputJSON;
+
+    std::vector <std::string>::iterator message;
+    for (message = outputFeedback.begin (); message != outputFeedback.end (); ++message)
+      context.footnote (*message);
   }
+  else
+  {
+    assertFeedback (outputFeedback);
 
-  context.timer_hooks.stop ();
+    std::vector <std::string>::iterator message;
+    for (message = outputFeedback.begin (); message != outputFeedback.end (); ++message)
+      context.error (*message);
+
+    throw 0;  // This is how hooks silently terminate processing.
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -365,12 +461,188 @@ void Hooks::onModify (const Task& before, Task& after)
   context.timer_hooks.stop ();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The on-modify-batch event is triggered once for all tasks modified by a
+// command, before they are saved.
+//
+// Input:
+// - line of JSON for the original task, followed by a line of JSON for the
+//   modified task, for each task modified
+//
+// Output:
+// - emitted JSON for each modified task, in the same order, is saved, if the
+//   exit code is zero, otherwise ignored.
+// - all emitted non-JSON lines are considered feedback or error messages
+//   depending on the status code.
+//
+void Hooks::onModify (const std::vector <Task>& before, std::vector <Task>& after)
+{
+  if (! _enabled || ! before.size ())
+    return;
+
+  context.timer_hooks.start ();
+
+  std::vector <std::string> batchScripts = scripts ("on-modify-batch");
+  if (batchScripts.size ())
+  {
+    std::vector <std::string> original;
+    std::vector <std::string> modified;
+    original.reserve (before.size ());
+    modified.reserve (after.size ());
+    for (unsigned int i = 0; i < before.size (); ++i)
+    {
+      original.push_back (before[i].composeJSON ());
+      modified.push_back (after[i].composeJSON ());
+    }
+
+    // Call the batch hook scripts, once for all tasks.
+    std::vector <std::string>::iterator script;
+    for (script = batchScripts.begin (); script != batchScripts.end (); ++script)
+    {
+      std::vector <std::string> input;
+      input.reserve (2 * before.size ());
+      for (unsigned int i = 0; i < before.size (); ++i)
+      {
+        input.push_back (original[i]);
+        input.push_back (modified[i]);
+      }
+
+      callTaskScript (*script, input, modified, &before[0], before.size ());
+    }
+
+    for (unsigned int i = 0; i < after.size (); ++i)
+      after[i] = Task (modified[i]);
+  }
+
+  context.timer_hooks.stop ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Persistent hook scripts see the end of their input, and are expected to
+// exit.
+void Hooks::finish ()
+{
+  std::map <std::string, Coprocess>::iterator c;
+  for (c = _coprocesses.begin (); c != _coprocesses.end (); ++c)
+  {
+    close (c->second.input);
+    close (c->second.output);
+
+    int status = -1;
+    waitpid (c->second.pid, &status, 0);
+  }
+
+  _coprocesses.clear ();
+
+  recordLatencies ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Whether the event would run any scripts.
+// Finding the scripts for an event checks each one on disk, so the answer is
+// kept for the rest of the command.
+bool Hooks::has (const std::string& event)
+{
+  if (! _enabled)
+    return false;
+
+  std::map <std::string, bool>::iterator i = _has.find (event);
+  if (i == _has.end ())
+    i = _has.insert (std::make_pair (event, scripts (event).size () > 0)).first;
+
+  return i->second;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::vector <std::string> Hooks::list ()
 {
   return _scripts;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The time taken by each script in recent commands, in usec, by script name.
+void Hooks::history (std::map <std::string, std::vector <unsigned long> >& latencies) const
+{
+  Path file (context.data_dir._data);
+  file += "hooks.latency";
+
+  std::vector <std::string> lines;
+  File::read (file._data, lines);
+
+  std::vector <std::string>::iterator line;
+  for (line = lines.begin (); line != lines.end (); ++line)
+  {
+    // <time> <script> <usec>
+    std::vector <std::string> fields;
+    split (fields, *line, ' ');
+    if (fields.size () == 3)
+      latencies[fields[1]].push_back (strtoul (fields[2].c_str (), NULL, 10));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The latency of each script run is appended to hooks.latency in the data
+// directory, so that the 'diagnostics' command can summarize recent runs.
+void Hooks::recordLatencies ()
+{
+  if (! _latencies.size ())
+    return;
+
+  // Only recorded on request, and never by a read-only command.
+  std::map <std::string, Command*>::iterator command = context.commands.find (context.cli.getCommand ());
+  if (! context.config.getBoolean ("hooks.latency") ||
+      context.tdb2.read_only ()                    ||
+      (command != context.commands.end () &&
+       command->second->read_only ()))
+  {
+    _latencies.clear ();
+    return;
+  }
+
+  std::string now = Date ().toEpochString ();
+  std::string lines;
+  std::vector <std::pair <std::string, unsigned long> >::iterator l;
+  for (l = _latencies.begin (); l != _latencies.end (); ++l)
+    lines += now + " " + l->first + " " + format ((int) l->second) + "\n";
+
+  _latencies.clear ();
+
+  Path path (context.data_dir._data);
+  path += "hooks.latency";
+
+  File file (path);
+  if (! file.open ())
+    return;
+
+  if (context.config.getBoolean ("locking"))
+    file.waitForLock ();
+
+  file.append (lines);
+  file.flush ();
+
+  // Only the most recent runs are kept, trimmed now and then.
+  if (file.size () > HOOK_LATENCY_RUNS * 64)
+  {
+    std::vector <std::string> all;
+    file.read (all);
+    if (all.size () > HOOK_LATENCY_RUNS)
+    {
+      all.erase (all.begin (), all.end () - HOOK_LATENCY_RUNS);
+      file.truncate ();
+      file.append (all);
+    }
+  }
+
+  file.close ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The time taken by each script run so far, in the order they finished.
+const std::vector <std::pair <std::string, unsigned long> >& Hooks::latencies () const
+{
+  return _latencies;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::vector <std::string> Hooks::scripts (const std::string& event)
 {
@@ -378,7 +650,10 @@ std::vector <std::string> Hooks::scripts (const std::string& event)
   std::vector <std::string>::iterator i;
   for (i = _scripts.begin (); i != _scripts.end (); ++i)
   {
-    if (i->find ("/" + event) != std::string::npos)
+    // Batch scripts are only matched by their own event.
+    std::string::size_type name = i->find ("/" + event);
+    if (name != std::string::npos &&
+        i->compare (name + 1 + event.length (), 6, "-batch") != 0)
     {
       File script (*i);
       if (script.executable ())
@@ -575,18 +850,38 @@ int Hooks::callHookScript (
 
   buildHookScriptArgs (args);
 
+  bool persistent = std::find (_persistent.begin (), _persistent.end (), Path (script).name ()) != _persistent.end ();
+
+  double limit = timeLimit ();
+
+  HighResTimer latency;
+  latency.start ();
+
   // Measure time for each hook if running in debug
   if (_debug >= 2)
   {
     Timer timer_per_hook("Hooks::execute (" + script + ")");
     timer_per_hook.start();
 
-    status = execute (script, args, inputStr, outputStr);
+    status = persistent ? callPersistentScript (script, input, output, limit)
+                        : execute (script, args, inputStr, outputStr, limit);
   }
   else
-    status = execute (script, args, inputStr, outputStr);
+    status = persistent ? callPersistentScript (script, input, output, limit)
+                        : execute (script, args, inputStr, outputStr, limit);
+
+  latency.stop ();
+  _spent += latency.total ();
+  _latencies.push_back (std::pair <std::string, unsigned long> (Path (script).name (), latency.total () * 1000000));
 
-  split (output, outputStr, '\n');
+  if (! persistent)
+  {
+    split (output, outputStr, '\n');
+
+    // The script was stopped, which fails it.
+    if (status == -1)
+      output.push_back (format (STRING_HOOK_ERROR_TIMEOUT, Path (script).name (), limit));
+  }
 
   if (_debug >= 2)
   {
@@ -604,3 +899,400 @@ int Hooks::callHookScript (
 }
 
 ////////////////////////////////////////////////////////////////////////////////
+// A persistent hook script is launched for its first event, and then receives
+// every event of the command as a line of JSON on its input:
+//
+//   {"seq":<n>,"tasks":[<task>,...]}
+//
+// For each event it emits the same output as the script would otherwise,
+// followed by a line that ends the reply, in any key order:
+//
+//   {"seq":<n>,"status":<exit code>}
+//
+int Hooks::callPersistentScript (
+  const std::string& script,
+  const std::vector <std::string>& input,
+  std::vector <std::string>& output,
+  double timeout)
+{
+  std::map <std::string, Coprocess>::iterator c = _coprocesses.find (script);
+  if (c == _coprocesses.end ())
+  {
+    std::vector <std::string> args;
+    buildHookScriptArgs (args);
+    args.push_back ("mode:persistent");
+
+    Coprocess coprocess;
+    coprocess.pid = launch (script, args, coprocess.input, coprocess.output);
+    coprocess.sequence = 0;
+    c = _coprocesses.insert (std::pair <std::string, Coprocess> (script, coprocess)).first;
+  }
+
+  Coprocess& coprocess = c->second;
+  int sequence = ++coprocess.sequence;
+
+  std::string tasks;
+  join (tasks, ",", input);
+  std::string event = format ("{\"seq\":{1},\"tasks\":[", sequence) + tasks + "]}\n";
+
+  // A script that went away is reported below, as a missing reply.
+  if (signal (SIGPIPE, SIG_IGN) == SIG_ERR)
+    throw std::string (std::strerror (errno));
+
+  std::string::size_type written = 0;
+  while (written < event.length ())
+  {
+    ssize_t n = write (coprocess.input, event.data () + written, event.length () - written);
+    if (n == -1 && errno == EINTR)
+      continue;
+
+    if (n <= 0)
+      break;
+
+    written += n;
+  }
+
+  if (signal (SIGPIPE, SIG_DFL) == SIG_ERR)
+    throw std::string (std::strerror (errno));
+
+  // Collect output lines up to the end of the reply.
+  struct timeval start;
+  gettimeofday (&start, NULL);
+
+  char buffer[16384];
+  std::string::size_type eol;
+  while (true)
+  {
+    while ((eol = coprocess.buffer.find ('\n')) == std::string::npos)
+    {
+      // A script that does not reply in time is stopped, which fails it.
+      if (timeout > 0.0)
+      {
+        struct timeval now;
+        gettimeofday (&now, NULL);
+        double remaining = timeout - (now.tv_sec  - start.tv_sec)
+                                   - (now.tv_usec - start.tv_usec) / 1000000.0;
+
+        fd_set rfds;
+        FD_ZERO (&rfds);
+        FD_SET (coprocess.output, &rfds);
+
+        struct timeval tv;
+        tv.tv_sec  = remaining > 0.0 ? (long) remaining : 0;
+        tv.tv_usec = remaining > 0.0 ? (long) ((remaining - tv.tv_sec) * 1000000) : 0;
+
+        int ready = select (coprocess.output + 1, &rfds, NULL, NULL, &tv);
+        if (ready == -1 && errno == EINTR)
+          continue;
+
+        if (ready == 0)
+        {
+          kill (coprocess.pid, SIGKILL);
+          close (coprocess.input);
+          close (coprocess.output);
+          waitpid (coprocess.pid, NULL, 0);
+          _coprocesses.erase (c);
+
+          output.push_back (format (STRING_HOOK_ERROR_TIMEOUT, Path (script).name (), timeout));
+          return -1;
+        }
+      }
+
+      ssize_t n = read (coprocess.output, buffer, sizeof (buffer));
+      if (n == -1 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+      {
+        context.error (format (STRING_HOOK_ERROR_NOREPLY, Path (script).name (), sequence));
+        throw 0;
+      }
+
+      coprocess.buffer.append (buffer, n);
+    }
+
+    std::string line = coprocess.buffer.substr (0, eol);
+    coprocess.buffer.erase (0, eol + 1);
+
+    // The reply is the object with a "seq" and a "status", but no "uuid".
+    json::object* reply = NULL;
+    if (isJSON (line) &&
+        line.find ("\"seq\"") != std::string::npos)
+    {
+      try
+      {
+        json::value* root = json::parse (line);
+        if (root->type () == json::j_object)
+          reply = (json::object*) root;
+        else
+          delete root;
+      }
+
+      catch (...)
+      {
+      }
+    }
+
+    json_object_iter seq;
+    json_object_iter status;
+    if (reply                                                            &&
+        (seq    = reply->_data.find ("seq"))    != reply->_data.end ()   &&
+        (status = reply->_data.find ("status")) != reply->_data.end ()   &&
+        reply->_data.find ("uuid")              == reply->_data.end ()   &&
+        seq->second->type ()    == json::j_number                        &&
+        status->second->type () == json::j_number)
+    {
+      bool current = (int) *(json::number*) seq->second == sequence;
+      int code     = (int) *(json::number*) status->second;
+      delete reply;
+
+      if (! current)
+      {
+        context.error (format (STRING_HOOK_ERROR_NOREPLY, Path (script).name (), sequence));
+        throw 0;
+      }
+
+      return code;
+    }
+
+    delete reply;
+    output.push_back (line);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs scripts that cannot affect each other concurrently, at most
+// rc.hooks.parallel at a time, each with the same input, and collects the
+// output and status of each.  A script still running after its time limit is
+// killed, and fails with an error message as its output.
+void Hooks::callHookScripts (
+  const std::vector <std::string>& scripts,
+  const std::vector <std::string>& input,
+  std::vector <std::vector <std::string> >& outputs,
+  std::vector <int>& statuses)
+{
+  outputs.assign (scripts.size (), std::vector <std::string> ());
+  statuses.assign (scripts.size (), 0);
+
+  // Without thread support the core count is unknown, and scripts run one at
+  // a time unless rc.hooks.parallel says otherwise.
+  int setting = context.config.getInteger ("hooks.parallel");
+  unsigned int limit = 1;
+  if (setting > 0)
+    limit = setting;
+#ifdef HAVE_LIBPTHREAD
+  else
+    limit = std::max (std::thread::hardware_concurrency (), 1u);
+#endif
+
+  // Persistent scripts keep their own protocol.
+  std::vector <unsigned int> pool;
+  for (unsigned int i = 0; i < scripts.size (); ++i)
+  {
+    if (std::find (_persistent.begin (), _persistent.end (), Path (scripts[i]).name ()) != _persistent.end ())
+      statuses[i] = callHookScript (scripts[i], input, outputs[i]);
+    else
+      pool.push_back (i);
+  }
+
+  if (! pool.size ())
+    return;
+
+  std::string inputStr;
+  std::vector <std::string>::const_iterator line;
+  for (line = input.begin (); line != input.end (); ++line)
+    inputStr += *line + "\n";
+
+  std::vector <std::string> args;
+  buildHookScriptArgs (args);
+
+  double timeout = timeLimit ();
+
+  struct timeval begin;
+  gettimeofday (&begin, NULL);
+
+  if (signal (SIGPIPE, SIG_IGN) == SIG_ERR) // Handled locally with EPIPE.
+    throw std::string (std::strerror (errno));
+
+  std::vector <HookJob> running;
+  std::vector <unsigned int>::iterator next = pool.begin ();
+  while (next != pool.end () || running.size ())
+  {
+    // Keep the pool full.
+    while (next != pool.end () && running.size () < limit)
+    {
+      if (_debug >= 1)
+        context.debug ("Hook: Calling " + scripts[*next]);
+
+      HookJob job;
+      job.index   = *next++;
+      job.written = 0;
+      job.exited  = false;
+      job.status  = -1;
+      gettimeofday (&job.start, NULL);
+      job.pid = launch (scripts[job.index], args, job.input, job.output);
+
+      if (inputStr.size () == 0)
+      {
+        close (job.input);
+        job.input = -1;
+      }
+
+      running.push_back (job);
+    }
+
+    fd_set rfds, wfds;
+    FD_ZERO (&rfds);
+    FD_ZERO (&wfds);
+    int maxfd = 0;
+    bool exiting = false;
+    std::vector <HookJob>::iterator job;
+    for (job = running.begin (); job != running.end (); ++job)
+    {
+      if (job->output != -1)
+      {
+        FD_SET (job->output, &rfds);
+        maxfd = std::max (maxfd, job->output);
+      }
+      else
+        exiting = true;
+
+      if (job->input != -1)
+      {
+        FD_SET (job->input, &wfds);
+        maxfd = std::max (maxfd, job->input);
+      }
+    }
+
+    // Wake up regularly to check the timeouts, and soon when a script that
+    // closed its output is yet to exit.
+    struct timeval tv;
+    tv.tv_sec  = 0;
+    tv.tv_usec = exiting ? 1000 : 100000;
+    if (select (maxfd + 1, &rfds, &wfds, NULL, &tv) == -1 &&
+        errno != EINTR)
+      throw std::string (std::strerror (errno));
+
+    for (job = running.begin (); job != running.end (); )
+    {
+      if (job->input != -1 &&
+          FD_ISSET (job->input, &wfds))
+      {
+        ssize_t n = write (job->input, inputStr.data () + job->written, inputStr.size () - job->written);
+
+        // A script that closed its input before reading it all does not care.
+        if (n == -1 && errno == EPIPE)
+          n = inputStr.size () - job->written;
+
+        if (n > 0)
+          job->written += n;
+
+        if (job->written == inputStr.size ())
+        {
+          close (job->input);
+          job->input = -1;
+        }
+      }
+
+      if (job->output != -1 &&
+          FD_ISSET (job->output, &rfds))
+      {
+        char buf[16384];
+        ssize_t n = read (job->output, buf, sizeof (buf));
+        if (n > 0)
+          job->received.append (buf, n);
+        else if (n == 0 || errno != EINTR)
+        {
+          close (job->output);
+          job->output = -1;
+        }
+      }
+
+      // A script that closed its output may still be running, so it is only
+      // finished once it exits, which is polled for within the time limit.
+      if (job->output == -1)
+      {
+        pid_t pid = waitpid (job->pid, &job->status, WNOHANG);
+        job->exited = pid == job->pid || pid == -1;
+      }
+
+      struct timeval now;
+      gettimeofday (&now, NULL);
+      double elapsed = (now.tv_sec  - job->start.tv_sec) +
+                       (now.tv_usec - job->start.tv_usec) / 1000000.0;
+      bool overrun = ! job->exited && timeout > 0.0 && elapsed > timeout;
+
+      if (job->exited || overrun)
+      {
+        if (job->input != -1)
+          close (job->input);
+        if (job->output != -1)
+          close (job->output);
+
+        // The killed script is reaped at once.
+        if (overrun)
+        {
+          kill (job->pid, SIGKILL);
+          waitpid (job->pid, &job->status, 0);
+        }
+
+        int status = job->status;
+
+        split (outputs[job->index], job->received, '\n');
+        if (overrun)
+        {
+          outputs[job->index].push_back (format (STRING_HOOK_ERROR_TIMEOUT, Path (scripts[job->index]).name (), timeout));
+          statuses[job->index] = -1;
+        }
+        else
+          statuses[job->index] = WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+
+        _latencies.push_back (std::pair <std::string, unsigned long> (Path (scripts[job->index]).name (), elapsed * 1000000));
+
+        if (_debug >= 2)
+        {
+          context.debug ("Hook: output of " + scripts[job->index]);
+          std::vector <std::string>::iterator i;
+          for (i = outputs[job->index].begin (); i != outputs[job->index].end (); ++i)
+            if (*i != "")
+              context.debug ("  " + *i);
+
+          context.debug (format ("Hook: Completed with status {1}", statuses[job->index]));
+          context.debug (" "); // Blank line
+        }
+
+        job = running.erase (job);
+      }
+      else
+        ++job;
+    }
+  }
+
+  struct timeval end;
+  gettimeofday (&end, NULL);
+  _spent += (end.tv_sec  - begin.tv_sec) +
+            (end.tv_usec - begin.tv_usec) / 1000000.0;
+
+  if (signal (SIGPIPE, SIG_DFL) == SIG_ERR) // We're done, return to default.
+    throw std::string (std::strerror (errno));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The time the next script may take, in seconds, which is the lesser of
+// rc.hooks.timeout and what is left of rc.hooks.timeout.total, or 0 for no
+// limit.
+double Hooks::timeLimit () const
+{
+  double limit = _timeout;
+  if (_budget > 0.0)
+  {
+    // A spent budget still gives the script an instant, so that it fails.
+    double remaining = std::max (_budget - _spent, 0.001);
+    if (limit <= 0.0 || remaining < limit)
+      limit = remaining;
+  }
+
+  return limit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
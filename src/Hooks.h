@@ -28,7 +28,9 @@
 #define INCLUDED_HOOKS
 
 #include <vector>
+#include <map>
 #include <string>
+#include <sys/types.h>
 #include <Task.h>
 
 class Hooks
@@ -45,12 +47,19 @@ public:
   void onLaunch ();
   void onExit ();
   void onAdd (Task&);
+  void onAdd (std::vector <Task>&);
   void onModify (const Task&, Task&);
+  void onModify (const std::vector <Task>&, std::vector <Task>&);
+  void finish ();
 
+  bool has (const std::string&);
   std::vector <std::string> list ();
+  const std::vector <std::pair <std::string, unsigned long> >& latencies () const;
+  void history (std::map <std::string, std::vector <unsigned long> >&) const;
 
 private:
   std::vector <std::string> scripts (const std::string&);
+  void onAdd (std::vector <Task>&, bool);
   void separateOutput (const std::vector <std::string>&, std::vector <std::string>&, std::vector <std::string>&) const;
   bool isJSON (const std::string&) const;
   void assertValidJSON (const std::vector <std::string>&) const;
@@ -59,11 +68,33 @@ private:
   void assertFeedback (const std::vector <std::string>&) const;
   std::vector <std::string>& buildHookScriptArgs (std::vector <std::string>&);
   int callHookScript (const std::string&, const std::vector <std::string>&, std::vector <std::string>&);
+  void callHookScripts (const std::vector <std::string>&, const std::vector <std::string>&, std::vector <std::vector <std::string> >&, std::vector <int>&);
+  int callPersistentScript (const std::string&, const std::vector <std::string>&, std::vector <std::string>&, double);
+  double timeLimit () const;
+  void recordLatencies ();
+  void callTaskScript (const std::string&, const std::vector <std::string>&, std::vector <std::string>&, const Task*, unsigned int);
 
 private:
-  bool                      _enabled;
-  int                       _debug;
-  std::vector <std::string> _scripts;
+  // A persistent hook script, running until the command finishes.
+  struct Coprocess
+  {
+    pid_t       pid;
+    int         input;
+    int         output;
+    int         sequence;
+    std::string buffer;
+  };
+
+  bool                               _enabled;
+  int                                _debug;
+  double                             _timeout;                   // Seconds per script
+  double                             _budget;                    // Seconds for all scripts
+  double                             _spent;
+  std::vector <std::string>          _scripts;
+  std::vector <std::string>          _persistent;
+  std::map <std::string, Coprocess>  _coprocesses;
+  std::map <std::string, bool>       _has;                       // Event -> has scripts
+  std::vector <std::pair <std::string, unsigned long> > _latencies;   // Script name, usec
 };
 
 #endif
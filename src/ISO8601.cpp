@@ -627,7 +627,8 @@ void ISO8601d::resolve ()
   }
 
   // Get 'now' in the relevant location.
-  struct tm* t_now = utc ? gmtime (&now) : localtime (&now);
+  struct tm local;
+  struct tm* t_now = utc ? gmtime_r (&now, &local) : localtime_r (&now, &local);
 
   int seconds_now = (t_now->tm_hour * 3600) +
                     (t_now->tm_min  *   60) +
@@ -0,0 +1,567 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cmake.h>
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <Snapshot.h>
+
+// Snapshot file layout.  All integers are stored in native byte order, which
+// is verified by the byte order mark, because a snapshot is never shared
+// between machines.
+//
+//   header   char[8] magic, uint32 byte order mark, uint32 version,
+//            uint64 text file size, int64 text mtime, int64 text mtime nsec,
+//            uint64 text checksum, uint32 name count, uint32 task count
+//   names    <name count> x (uint32 length, bytes)
+//   offsets  <task count> x (uint64 offset of record, uint64 offset of line)
+//   records  uint32 attribute count, then for each attribute:
+//              uint32 name index, uint8 kind, value
+//              kind 'd' value: int64 epoch
+//              kind 's' value: uint32 length, bytes
+//
+static const char     magic[8]   = {'T', 'W', 'S', 'N', 'A', 'P', '\0', '\0'};
+static const uint32_t byte_order = 0x01020304;
+static const uint32_t version    = 3;
+
+////////////////////////////////////////////////////////////////////////////////
+// Bounds-checked reader over the mapped snapshot.
+class Reader
+{
+public:
+  Reader (const char* data, size_t size)
+  : _data (data)
+  , _size (size)
+  , _cursor (0)
+  {
+  }
+
+  bool seek (uint64_t offset)
+  {
+    if (offset > _size)
+      return false;
+
+    _cursor = offset;
+    return true;
+  }
+
+  template <class T> bool get (T& value)
+  {
+    if (_cursor + sizeof (T) > _size)
+      return false;
+
+    memcpy (&value, _data + _cursor, sizeof (T));
+    _cursor += sizeof (T);
+    return true;
+  }
+
+  bool get (std::string& value)
+  {
+    uint32_t length;
+    if (! get (length) ||
+        _cursor + length > _size)
+      return false;
+
+    value.assign (_data + _cursor, length);
+    _cursor += length;
+    return true;
+  }
+
+private:
+  const char* _data;
+  size_t      _size;
+  size_t      _cursor;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template <class T> static void put (std::string& buffer, T value)
+{
+  buffer.append ((const char*) &value, sizeof (T));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void put (std::string& buffer, const std::string& value)
+{
+  put (buffer, (uint32_t) value.length ());
+  buffer.append (value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int64_t mtime_nsec (const struct stat& s)
+{
+#ifdef HAVE_ST_MTIM
+  return s.st_mtim.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Continues the FNV-1a hash of the text file over the bytes from..to, which
+// lets a snapshot of an earlier state be checked against a file that has since
+// grown.  The hash of nothing is the offset basis.
+static const uint64_t checksum_basis = 0xcbf29ce484222325ULL;
+
+static bool checksum (const std::string& file, uint64_t from, uint64_t to, uint64_t& sum)
+{
+  if (from == to)
+    return true;
+
+  int fd = open (file.c_str (), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  unsigned char buffer[65536];
+  while (from < to)
+  {
+    ssize_t n = pread (fd, buffer, std::min ((uint64_t) sizeof (buffer), to - from), from);
+    if (n <= 0)
+    {
+      close (fd);
+      return false;
+    }
+
+    for (ssize_t i = 0; i < n; ++i)
+    {
+      sum ^= buffer[i];
+      sum *= 0x100000001b3ULL;
+    }
+
+    from += n;
+  }
+
+  close (fd);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Only canonical epoch values are stored as fixed-width dates, so that the
+// conversion back to text is exact.
+static bool isEpoch (const std::string& value, int64_t& epoch)
+{
+  if (value.length () == 0  ||
+      value.length () > 18  ||
+      (value[0] == '0' && value.length () > 1))
+    return false;
+
+  for (unsigned int i = 0; i < value.length (); ++i)
+    if (value[i] < '0' || value[i] > '9')
+      return false;
+
+  epoch = strtoll (value.c_str (), NULL, 10);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool isDate (const std::string& name)
+{
+  std::map <std::string, std::string>::const_iterator type;
+  type = Task::attributes.find (name);
+  return type != Task::attributes.end () &&
+         type->second == "date";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool decode (
+  const char* data,
+  size_t size,
+  const std::string& file,
+  const struct stat& text,
+  std::vector <Task>& tasks,
+  std::vector <unsigned long long>& lines,
+  uint64_t* prefix,
+  uint64_t& sum)
+{
+  Reader r (data, size);
+
+  char     m[8];
+  uint32_t bom;
+  uint32_t ver;
+  uint64_t text_size;
+  int64_t  text_mtime;
+  int64_t  text_nsec;
+  uint64_t text_sum;
+  uint32_t name_count;
+  uint32_t task_count;
+
+  if (! r.get (m)                                 ||
+      memcmp (m, magic, sizeof (magic))           ||
+      ! r.get (bom)        || bom != byte_order   ||
+      ! r.get (ver)        || ver != version      ||
+      ! r.get (text_size)  ||
+      ! r.get (text_mtime) ||
+      ! r.get (text_nsec)  ||
+      ! r.get (text_sum)   ||
+      ! r.get (name_count) ||
+      ! r.get (task_count))
+    return false;
+
+  if (prefix)
+  {
+    if (text_size > (uint64_t) text.st_size)
+      return false;
+
+    // A file that changed since may have been rewritten rather than appended
+    // to, so the covered bytes must be unchanged.
+    if (text_size  != (uint64_t) text.st_size  ||
+        text_mtime != (int64_t)  text.st_mtime ||
+        text_nsec  != mtime_nsec (text))
+    {
+      uint64_t verified = checksum_basis;
+      if (! checksum (file, 0, text_size, verified) ||
+          verified != text_sum)
+        return false;
+    }
+
+    *prefix = text_size;
+  }
+  else if (text_size  != (uint64_t) text.st_size  ||
+           text_mtime != (int64_t)  text.st_mtime ||
+           text_nsec  != mtime_nsec (text))
+    return false;
+
+  sum = text_sum;
+
+  std::vector <std::string> names (name_count);
+  std::vector <const std::string*> interned (name_count);
+  for (uint32_t n = 0; n < name_count; ++n)
+  {
+    if (! r.get (names[n]))
+      return false;
+
+    interned[n] = Attributes::intern (names[n]);
+  }
+
+  std::vector <uint64_t> offsets (task_count);
+  lines.resize (task_count);
+  for (uint32_t t = 0; t < task_count; ++t)
+  {
+    uint64_t line;
+    if (! r.get (offsets[t]) ||
+        ! r.get (line))
+      return false;
+
+    lines[t] = line;
+  }
+
+  tasks.reserve (tasks.size () + task_count);
+
+  std::string value;
+  char number[32];
+  for (uint32_t t = 0; t < task_count; ++t)
+  {
+    uint32_t attribute_count;
+    if (! r.seek (offsets[t]) ||
+        ! r.get (attribute_count))
+      return false;
+
+    Task task;
+    for (uint32_t a = 0; a < attribute_count; ++a)
+    {
+      uint32_t name;
+      uint8_t kind;
+      if (! r.get (name) || name >= name_count ||
+          ! r.get (kind))
+        return false;
+
+      if (kind == 'd')
+      {
+        int64_t epoch;
+        if (! r.get (epoch))
+          return false;
+
+        snprintf (number, sizeof (number), "%lld", (long long) epoch);
+        task.append (interned[name], number, epoch);
+      }
+      else if (kind == 's' && r.get (value))
+        task.append (interned[name], value);
+      else
+        return false;
+
+      if (names[name].compare (0, 11, "annotation_") == 0)
+        ++task.annotation_count;
+    }
+
+    tasks.push_back (task);
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Snapshot::Snapshot ()
+: _data ("")
+, _size (0)
+, _mtime (0)
+, _nsec (-1)
+, _inode (0)
+, _summed (0)
+, _sum (checksum_basis)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Snapshot::~Snapshot ()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Snapshot::target (const std::string& file)
+{
+  _data = file;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Appends the tasks stored in the snapshot, provided the snapshot still
+// represents the current state of the text file, and optionally the line
+// offsets of those tasks.  Given a prefix, the snapshot may instead describe
+// an earlier state of an append-only file, whose size is returned, and it is
+// up to the caller to verify and index the rest.
+bool Snapshot::load (
+  const File& text,
+  std::vector <Task>& tasks,
+  std::vector <unsigned long long>* lines /* = NULL */,
+  unsigned long long* prefix /* = NULL */)
+{
+  struct stat t;
+  if (_data == "" ||
+      stat (text._data.c_str (), &t))
+    return false;
+
+  int fd = open (_data.c_str (), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat s;
+  if (fstat (fd, &s) ||
+      s.st_size == 0)
+  {
+    close (fd);
+    return false;
+  }
+
+  // A snapshot older than the text file cannot describe it.  Writers refresh
+  // or invalidate the snapshot while they still hold the file lock.
+  if (! prefix &&
+      (s.st_mtime < t.st_mtime ||
+       (s.st_mtime == t.st_mtime && mtime_nsec (s) < mtime_nsec (t))))
+  {
+    close (fd);
+    return false;
+  }
+
+  void* map = mmap (NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  std::vector <Task> loaded;
+  std::vector <unsigned long long> offsets;
+  uint64_t covered = t.st_size;
+  uint64_t sum;
+  bool valid = decode ((const char*) map, s.st_size, text._data, t, loaded, offsets,
+                       prefix ? &covered : NULL, sum);
+  munmap (map, s.st_size);
+
+  if (valid)
+  {
+    tasks.insert (tasks.end (), loaded.begin (), loaded.end ());
+    if (lines)
+      *lines = offsets;
+
+    if (prefix)
+      *prefix = covered;
+    else
+      remember (t);
+
+    _inode  = t.st_ino;
+    _summed = covered;
+    _sum    = sum;
+  }
+
+  return valid;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writes tasks[first..] as the snapshot of the text file, which must contain
+// exactly those tasks, at the given line offsets if known.  The snapshot is
+// replaced atomically.
+bool Snapshot::save (
+  const File& text,
+  const std::vector <Task>& tasks,
+  unsigned int first /* = 0 */,
+  const std::vector <unsigned long long>* lines /* = NULL */)
+{
+  struct stat t;
+  if (_data == "" ||
+      stat (text._data.c_str (), &t))
+    return false;
+
+  if (lines && lines->size () != tasks.size () - first)
+    return false;
+
+  // The file is only appended to while the same inode, so the checksum is
+  // continued from the last known state of it.
+  if (_inode != (unsigned long long) t.st_ino ||
+      _summed > (unsigned long long) t.st_size)
+  {
+    _summed = 0;
+    _sum    = checksum_basis;
+  }
+
+  uint64_t sum = _sum;
+  if (! checksum (text._data, _summed, t.st_size, sum))
+    return false;
+
+  // Intern all attribute names.
+  std::map <std::string, uint32_t> ids;
+  std::vector <Task>::const_iterator task;
+  Task::const_iterator att;
+  for (task = tasks.begin () + first; task != tasks.end (); ++task)
+    for (att = task->begin (); att != task->end (); ++att)
+      ids[att->first] = 0;
+
+  std::vector <bool> dates;
+  uint32_t next = 0;
+  std::map <std::string, uint32_t>::iterator id;
+  for (id = ids.begin (); id != ids.end (); ++id)
+  {
+    id->second = next++;
+    dates.push_back (isDate (id->first));
+  }
+
+  std::string buffer;
+  buffer.append (magic, sizeof (magic));
+  put (buffer, byte_order);
+  put (buffer, version);
+  put (buffer, (uint64_t) t.st_size);
+  put (buffer, (int64_t)  t.st_mtime);
+  put (buffer, (int64_t)  mtime_nsec (t));
+  put (buffer, sum);
+  put (buffer, (uint32_t) ids.size ());
+  put (buffer, (uint32_t) (tasks.size () - first));
+
+  for (id = ids.begin (); id != ids.end (); ++id)
+    put (buffer, id->first);
+
+  // Reserve the offset table, which is filled in as records are written.
+  std::string::size_type slot = buffer.length ();
+  buffer.append ((tasks.size () - first) * 2 * sizeof (uint64_t), '\0');
+
+  int64_t epoch;
+  uint64_t offset;
+  uint64_t line;
+  unsigned int n = 0;
+  for (task = tasks.begin () + first; task != tasks.end (); ++task, ++n)
+  {
+    offset = buffer.length ();
+    memcpy (&buffer[slot], &offset, sizeof (offset));
+    slot += sizeof (offset);
+
+    line = lines ? (*lines)[n] : 0;
+    memcpy (&buffer[slot], &line, sizeof (line));
+    slot += sizeof (line);
+
+    put (buffer, (uint32_t) task->size ());
+    for (att = task->begin (); att != task->end (); ++att)
+    {
+      uint32_t name = ids[att->first];
+      put (buffer, name);
+
+      if (dates[name] && isEpoch (att->second, epoch))
+      {
+        put (buffer, (uint8_t) 'd');
+        put (buffer, epoch);
+      }
+      else
+      {
+        put (buffer, (uint8_t) 's');
+        put (buffer, att->second);
+      }
+    }
+  }
+
+  std::string temp = _data + ".tmp";
+  FILE* out = fopen (temp.c_str (), "w");
+  if (! out)
+    return false;
+
+  bool written = fwrite (buffer.data (), 1, buffer.length (), out) == buffer.length ();
+  if (fclose (out) || ! written ||
+      rename (temp.c_str (), _data.c_str ()))
+  {
+    unlink (temp.c_str ());
+    return false;
+  }
+
+  remember (t);
+  _inode  = t.st_ino;
+  _summed = t.st_size;
+  _sum    = sum;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Whether the text file is still in the state the snapshot was last loaded or
+// saved for.
+bool Snapshot::current (const File& text) const
+{
+  struct stat t;
+  return stat (text._data.c_str (), &t) == 0      &&
+         _size  == (unsigned long long) t.st_size &&
+         _mtime == (long long) t.st_mtime         &&
+         _nsec  == (long long) mtime_nsec (t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Snapshot::remove ()
+{
+  _nsec   = -1;
+  _inode  = 0;
+  _summed = 0;
+  _sum    = checksum_basis;
+  return unlink (_data.c_str ()) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Snapshot::remember (const struct stat& text)
+{
+  _size  = text.st_size;
+  _mtime = text.st_mtime;
+  _nsec  = mtime_nsec (text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// vim: ts=2 et sw=2
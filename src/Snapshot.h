@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef INCLUDED_SNAPSHOT
+#define INCLUDED_SNAPSHOT
+
+#include <vector>
+#include <string>
+#include <File.h>
+#include <Task.h>
+
+// Snapshot is a binary, memory-mappable image of the tasks in one data file.
+// It is a cache only: the text file remains the source of truth, and the
+// snapshot is only used while it matches the size and mtime of that file, or
+// the checksum of its start, for a file that is appended to.
+// Each task also records the byte offset of its line in the text file.
+class Snapshot
+{
+public:
+  Snapshot ();
+  ~Snapshot ();
+
+  void target (const std::string&);
+  bool load (const File&, std::vector <Task>&, std::vector <unsigned long long>* lines = NULL, unsigned long long* prefix = NULL);
+  bool save (const File&, const std::vector <Task>&, unsigned int first = 0, const std::vector <unsigned long long>* lines = NULL);
+  bool current (const File&) const;
+  bool remove ();
+
+private:
+  void remember (const struct stat&);
+
+public:
+  std::string _data;
+
+private:
+  unsigned long long _size;
+  long long _mtime;
+  long long _nsec;
+  unsigned long long _inode;                   // Text file the checksum covers
+  unsigned long long _summed;                  // Bytes of it covered
+  unsigned long long _sum;
+};
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -27,14 +27,25 @@
 #include <cmake.h>
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <algorithm>
+#include <exception>
 #include <list>
 #include <set>
+#include <unordered_set>
+#ifdef HAVE_LIBPTHREAD
+#include <thread>
+#endif
 #include <stdlib.h>
 #include <signal.h>
+#include <unistd.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
 #include <Context.h>
 #include <Color.h>
 #include <Date.h>
+#include <Directory.h>
 #include <i18n.h>
 #include <text.h>
 #include <util.h>
@@ -43,6 +54,212 @@
 
 extern Context context;
 
+// Attributes held in the index of a data file.  These are enough to decide
+// most filters on completed tasks without parsing the tasks themselves.
+static const char* indexed_attributes[] =
+{
+  "end",
+  "modified",
+  "project",
+  "status",
+  "tags",
+  "uuid",
+};
+
+#define NUM_INDEXED_ATTRIBUTES (sizeof (indexed_attributes) / sizeof (indexed_attributes[0]))
+
+////////////////////////////////////////////////////////////////////////////////
+// The part of a task that is held in the index.
+static Task skeleton (const Task& task)
+{
+  Task skeleton;
+  for (unsigned int i = 0; i < NUM_INDEXED_ATTRIBUTES; ++i)
+  {
+    Task::const_iterator att = task.find (indexed_attributes[i]);
+    if (att != task.end ())
+      skeleton[att->first] = att->second;
+  }
+
+  return skeleton;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A tombstone is appended when a task moves out of a file, and cancels the
+// preceding record of that task, so that the file need not be rewritten.  It
+// is a task record that only holds the UUID, behind a keyword that no task
+// record starts with, so it cannot be mistaken for a task, and versions that
+// do not know it report an error instead.
+#define TOMBSTONE_KEYWORD "relocated "
+
+static void composeTombstone (const std::string& uuid, std::string& contents)
+{
+  Task tombstone;
+  tombstone.set ("uuid", uuid);
+
+  contents += TOMBSTONE_KEYWORD;
+  tombstone.composeF4 (contents);
+  contents += '\n';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool isTombstone (const std::string& line)
+{
+  return line.compare (0, sizeof (TOMBSTONE_KEYWORD) - 1, TOMBSTONE_KEYWORD) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tombstones change the file format, so they are only written when asked for.
+// Journal mode needs them anyway.
+static bool tombstones ()
+{
+  return context.config.getBoolean ("data.tombstones") ||
+         context.config.getBoolean ("data.journal");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// In journal mode, a modified task is appended as a journal record, which
+// replaces the preceding record of that task in place.  Like a tombstone, it
+// is marked by a keyword in front of the task record, not by an attribute.
+#define JOURNAL_KEYWORD "journal "
+
+static void composeJournalRecord (const Task& task, std::string& contents)
+{
+  contents += JOURNAL_KEYWORD;
+  task.composeF4 (contents);
+  contents += '\n';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool isJournalRecord (const std::string& line)
+{
+  return line.compare (0, sizeof (JOURNAL_KEYWORD) - 1, JOURNAL_KEYWORD) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The task record of a line, without any journal keyword.
+static std::string taskRecord (const std::string& line)
+{
+  if (isJournalRecord (line))
+    return line.substr (sizeof (JOURNAL_KEYWORD) - 1);
+
+  return line;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The UUID of the task in an undo line, which is an attribute, not some text
+// that happens to look like one.
+static std::string transactionUUID (const std::string& line)
+{
+  std::string::size_type uuid = 0;
+  while ((uuid = line.find ("uuid:\"", uuid)) != std::string::npos)
+  {
+    if (uuid > 0 &&
+        (line[uuid - 1] == '[' || line[uuid - 1] == ' ') &&
+        uuid + 6 + 36 <= line.length ())
+      return line.substr (uuid + 6, 36);
+
+    ++uuid;
+  }
+
+  return "";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the lines of the transaction at the offset, up to its separator.
+static void readTransaction (
+  std::ifstream& in,
+  unsigned long long offset,
+  std::vector <std::string>& lines)
+{
+  in.clear ();
+  in.seekg (offset);
+
+  std::string line;
+  while (getline (in, line))
+  {
+    lines.push_back (line);
+    if (line == "---")
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Undo segments are named undo.<n>.data, or undo.<n>.data.gz once compressed,
+// where later segments have higher numbers.
+static std::map <int, std::string> undoSegments (const std::string& location)
+{
+  std::map <int, std::string> segments;
+
+  Directory dir (location);
+  std::vector <std::string> files = dir.list ();
+  std::vector <std::string>::iterator file;
+  for (file = files.begin (); file != files.end (); ++file)
+  {
+    std::string name = Path (*file).name ();
+    if (name.compare (0, 5, "undo.") != 0)
+      continue;
+
+    std::string::size_type end = name.find_first_not_of ("0123456789", 5);
+    if (end == 5 ||
+        end == std::string::npos)
+      continue;
+
+    std::string suffix = name.substr (end);
+    int n = strtol (name.substr (5, end - 5).c_str (), NULL, 10);
+    if (suffix == ".data")
+      segments[n] = *file;
+    else if (suffix == ".data.gz" &&
+             segments.find (n) == segments.end ())
+      segments[n] = *file;
+  }
+
+  return segments;
+}
+
+#ifdef HAVE_LIBZ
+////////////////////////////////////////////////////////////////////////////////
+// The compressed copy replaces the segment only once it is complete.
+static bool compressSegment (const std::string& segment)
+{
+  std::ifstream in (segment.c_str (), std::ios::binary);
+  std::stringstream contents;
+  contents << in.rdbuf ();
+  std::string data = contents.str ();
+
+  std::string temp = segment + ".gz.tmp";
+  gzFile out = gzopen (temp.c_str (), "wb");
+  if (! out)
+    return false;
+
+  bool written = data.length () == 0 ||
+                 gzwrite (out, data.data (), data.length ()) == (int) data.length ();
+  if (gzclose (out) != Z_OK || ! written ||
+      rename (temp.c_str (), (segment + ".gz").c_str ()))
+  {
+    unlink (temp.c_str ());
+    return false;
+  }
+
+  unlink (segment.c_str ());
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool decompressSegment (const std::string& segment, std::string& data)
+{
+  gzFile in = gzopen (segment.c_str (), "rb");
+  if (! in)
+    return false;
+
+  char buffer[65536];
+  int count;
+  while ((count = gzread (in, buffer, sizeof (buffer))) > 0)
+    data.append (buffer, count);
+
+  return gzclose (in) == Z_OK && count == 0;
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 TF2::TF2 ()
 : _read_only (false)
@@ -51,6 +268,13 @@ TF2::TF2 ()
 , _loaded_lines (false)
 , _has_ids (false)
 , _auto_dep_scan (false)
+, _indexed (false)
+, _transactional (false)
+, _loaded_index (false)
+, _compact (false)
+, _indexed_size (0)
+, _graph_current (false)
+, _inheritance_current (false)
 {
 }
 
@@ -66,6 +290,8 @@ TF2::~TF2 ()
 void TF2::target (const std::string& f)
 {
   _file = File (f);
+  _snapshot.target (_file._data + ".snapshot");
+  _index.target (_file._data + ".index");
 
   // A missing file is not considered unwritable.
   _read_only = false;
@@ -98,17 +324,12 @@ bool TF2::get (int id, Task& task)
   if (! _loaded_tasks)
     load_tasks ();
 
-  // This is an optimization.  Since the 'id' is based on the line number of
-  // pending.data file, the task in question cannot appear earlier than line
-  // (id - 1) in the file.  It can, however, appear significantly later because
-  // it is not known how recent a GC operation was run.
-  for (unsigned int i = id - 1; i < _tasks.size (); ++i)
+  if (id > 0 &&
+      id < (int) _id_slots.size () &&
+      _id_slots[id] != -1)
   {
-    if (_tasks[i].id == id)
-    {
-      task = _tasks[i];
-      return true;
-    }
+    task = _tasks[_id_slots[id]];
+    return true;
   }
 
   return false;
@@ -121,14 +342,11 @@ bool TF2::get (const std::string& uuid, Task& task)
   if (! _loaded_tasks)
     load_tasks ();
 
-  std::vector <Task>::iterator i;
-  for (i = _tasks.begin (); i != _tasks.end (); ++i)
+  std::unordered_map <std::string, unsigned int>::const_iterator i;
+  if ((i = _uuid_slots.find (uuid)) != _uuid_slots.end ())
   {
-    if (i->get ("uuid") == uuid)
-    {
-      task = *i;
-      return true;
-    }
+    task = _tasks[i->second];
+    return true;
   }
 
   return false;
@@ -140,20 +358,12 @@ bool TF2::has (const std::string& uuid)
   if (! _loaded_tasks)
     load_tasks ();
 
-  std::vector <Task>::iterator i;
-  for (i = _tasks.begin (); i != _tasks.end (); ++i)
-    if (i->get ("uuid") == uuid)
-      return true;
-
-  return false;
+  return _uuid_slots.find (uuid) != _uuid_slots.end ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void TF2::add_task (Task& task)
 {
-  _tasks.push_back (task);           // For subsequent queries
-  _added_tasks.push_back (task);     // For commit/synch
-
   Task::status status = task.getStatus ();
   if (task.id == 0 &&
       (status == Task::pending   ||
@@ -163,28 +373,95 @@ void TF2::add_task (Task& task)
     task.id = context.tdb2.next_id ();
   }
 
-  _I2U[task.id] = task.get ("uuid");
-  _U2I[task.get ("uuid")] = task.id;
+  _tasks.push_back (task);           // For subsequent queries
+  _added_tasks.push_back (task);     // For commit/synch
+  index_task (_tasks.size () - 1);
+
+  _graph_current = false;
+  _dirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tasks moved here from another file by gc are appended on commit, but are not
+// reported as changes, because they did not change.
+void TF2::relocate_task (const Task& task)
+{
+  _tasks.push_back (task);
+  _relocated_tasks.push_back (task);
+  index_task (_tasks.size () - 1);
+
+  _graph_current = false;
+  _dirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::remove_task (const Task& task)
+{
+  remove_tasks (std::vector <std::string> (1, task.get ("uuid")));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tasks moved from here to another file by gc, or removed by undo, are
+// cancelled by tombstones appended on commit.  Without tombstones, the file is
+// rewritten without them, for which all its tasks are loaded first.
+void TF2::remove_tasks (const std::vector <std::string>& uuids)
+{
+  if (tombstones ())
+    _removed_uuids.insert (_removed_uuids.end (), uuids.begin (), uuids.end ());
+  else
+  {
+    get_tasks ();
+    _compact = true;
+  }
 
+  drop (uuids);
   _dirty = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 bool TF2::modify_task (const Task& task)
 {
-  // Modify in-place.
-  std::string uuid = task.get ("uuid");
-  std::vector <Task>::iterator i;
-  for (i = _tasks.begin (); i != _tasks.end (); ++i)
+  if (store_task (task))
   {
-    if (i->get ("uuid") == uuid)
-    {
-      *i = task;
-      _modified_tasks.push_back (task);
-      _dirty = true;
+    _modified_tasks.push_back (task);
+    return true;
+  }
 
-      return true;
-    }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Replaces a modification made earlier in this command, by its position among
+// the modified tasks, so that the task is still reported and written once.
+bool TF2::replace_modified (unsigned int modified, const Task& task)
+{
+  if (modified < _modified_tasks.size () &&
+      _modified_tasks[modified].get ("uuid") == task.get ("uuid") &&
+      store_task (task))
+  {
+    _modified_tasks[modified] = task;
+    return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tasks restored in place by undo are written like modified tasks, but are not
+// reported as changes.
+bool TF2::replace_task (const Task& task)
+{
+  std::unordered_map <std::string, unsigned int>::const_iterator i;
+  if ((i = _uuid_slots.find (task.get ("uuid"))) != _uuid_slots.end ())
+  {
+    if (_tasks[i->second].get_ref ("depends") != task.get_ref ("depends"))
+      _graph_current = false;
+
+    _tasks[i->second] = task;
+    _inheritance_current = false;
+    _replaced_tasks.push_back (task);
+    _dirty = true;
+    return true;
   }
 
   return false;
@@ -198,10 +475,26 @@ void TF2::add_line (const std::string& line)
   _dirty = true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Replaces a line added since the file was loaded, by its position among the
+// added lines.
+void TF2::replace_line (unsigned int added, const std::string& line)
+{
+  unsigned int loaded = _lines.size () - _added_lines.size ();
+  if (_lines.size () >= _added_lines.size () &&
+      _lines[loaded + added] == _added_lines[added])
+    _lines[loaded + added] = line;
+
+  _added_lines[added] = line;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void TF2::clear_tasks ()
 {
   _tasks.clear ();
+  _uuid_slots.clear ();
+  _id_slots.clear ();
+  _graph_current = false;
   _dirty = true;
 }
 
@@ -219,25 +512,105 @@ void TF2::commit ()
   // The _dirty flag indicates that the file needs to be written.
   if (_dirty)
   {
-    // Special case: added but no modified means just append to the file.
-    if (!_modified_tasks.size () &&
-        (_added_tasks.size () || _added_lines.size ()))
+    // Special case: added but no modified means just append to the file.  In
+    // journal mode, modified tasks are appended too, until compaction.
+    bool journal = context.config.getBoolean ("data.journal");
+    if (! _compact &&
+        (journal || (! _modified_tasks.size () && ! _replaced_tasks.size ())) &&
+        (_added_tasks.size ()     ||
+         _relocated_tasks.size () ||
+         _modified_tasks.size ()  ||
+         _replaced_tasks.size ()  ||
+         _removed_uuids.size ()   ||
+         _added_lines.size ()))
     {
       if (_file.open ())
       {
         if (context.config.getBoolean ("locking"))
           _file.waitForLock ();
 
-        // Write out all the added tasks.
+        // The index is extended along with the file, provided it describes
+        // the file as it is now.
+        bool extend = false;
+        if (_indexed                               &&
+            context.config.getBoolean ("snapshot") &&
+            ! _added_lines.size ())
+        {
+          if (! _loaded_index)
+            _loaded_index = _index.load (_file, _index_tasks, &_index_lines);
+
+          extend = _loaded_index && _index.current (_file);
+        }
+
+        // All records are composed into one buffer, which is appended in a
+        // single write.  The tombstones come first, as a task may return later.
+        unsigned long long size = _file.size ();
+        std::string contents;
+        std::vector <std::string>::iterator uuid;
+        for (uuid = _removed_uuids.begin ();
+             uuid != _removed_uuids.end ();
+             ++uuid)
+          composeTombstone (*uuid, contents);
+
+        if (extend)
+          drop (_removed_uuids);
+
+        _removed_uuids.clear ();
+
+        // Write out all the added and relocated tasks.
+        std::vector <Task> appended (_added_tasks);
+        appended.insert (appended.end (), _relocated_tasks.begin (), _relocated_tasks.end ());
+
         std::vector <Task>::iterator task;
-        for (task = _added_tasks.begin ();
-             task != _added_tasks.end ();
+        for (task = appended.begin ();
+             task != appended.end ();
              ++task)
         {
-          _file.append (task->composeF4 () + "\n");
+          if (extend)
+          {
+            _index_tasks.push_back (skeleton (*task));
+            _index_lines.push_back (size + contents.length ());
+          }
+
+          task->composeF4 (contents);
+          contents += '\n';
         }
 
         _added_tasks.clear ();
+        _relocated_tasks.clear ();
+
+        // Write out the journal records, which follow the records they
+        // replace.
+        std::vector <Task> journaled (_replaced_tasks);
+        journaled.insert (journaled.end (), _modified_tasks.begin (), _modified_tasks.end ());
+
+        for (task = journaled.begin ();
+             task != journaled.end ();
+             ++task)
+        {
+          if (extend)
+          {
+            std::string uuid = task->get ("uuid");
+            unsigned int i = 0;
+            while (i < _index_tasks.size () &&
+                   _index_tasks[i].get ("uuid") != uuid)
+              ++i;
+
+            if (i == _index_tasks.size ())
+            {
+              _index_tasks.push_back (Task ());
+              _index_lines.push_back (0);
+            }
+
+            _index_tasks[i] = skeleton (*task);
+            _index_lines[i] = size + contents.length ();
+          }
+
+          composeJournalRecord (*task, contents);
+        }
+
+        _replaced_tasks.clear ();
+        _modified_tasks.clear ();
 
         // Write out all the added lines.
         std::vector <std::string>::iterator line;
@@ -245,10 +618,25 @@ void TF2::commit ()
              line != _added_lines.end ();
              ++line)
         {
-          _file.append (*line);
+          contents += *line;
         }
 
+        _file.append (contents);
         _added_lines.clear ();
+
+        if (extend)
+        {
+          _file.flush ();
+          if (! _index.save (_file, _index_tasks, 0, &_index_lines))
+            _index.remove ();
+        }
+        else
+        {
+          _loaded_index = false;
+          _index_tasks.clear ();
+          _index_lines.clear ();
+        }
+
         _file.close ();
         _dirty = false;
       }
@@ -260,16 +648,20 @@ void TF2::commit ()
         if (context.config.getBoolean ("locking"))
           _file.waitForLock ();
 
-        // Truncate the file and rewrite.
-        _file.truncate ();
-
         // Only write out _tasks, because any deltas have already been applied.
+        // The records are composed into one buffer, sized after the file.
+        std::vector <unsigned long long> lines;
+        lines.reserve (_tasks.size ());
+        std::string contents;
+        contents.reserve (_file.size () + _file.size () / 8);
         std::vector <Task>::iterator task;
         for (task = _tasks.begin ();
              task != _tasks.end ();
              ++task)
         {
-          _file.append (task->composeF4 () + "\n");
+          lines.push_back (contents.length ());
+          task->composeF4 (contents);
+          contents += '\n';
         }
 
         // Write out all the added lines.
@@ -278,12 +670,39 @@ void TF2::commit ()
              line != _added_lines.end ();
              ++line)
         {
-          _file.append (*line);
+          contents += *line;
+        }
+
+        // Replace the file as a whole, rather than truncating and rewriting it,
+        // so that a failure leaves the previous file intact.
+        if (! _file.replace (contents))
+        {
+          _file.close ();
+          throw format (STRING_TDB2_WRITE_ERROR, _file._data);
+        }
+
+        // Refresh the snapshots while the file is still locked, so that no
+        // other writer can intervene, otherwise discard them.
+        if (context.config.getBoolean ("snapshot") &&
+            _loaded_tasks                          &&
+            ! _added_lines.size ())
+        {
+          if (! _snapshot.save (_file, _tasks, 0, &lines))
+            _snapshot.remove ();
+
+          if (_indexed)
+            build_index (0, lines);
         }
+        else
+          remove_snapshots ();
 
         _added_lines.clear ();
+        _relocated_tasks.clear ();
+        _replaced_tasks.clear ();
+        _removed_uuids.clear ();
         _file.close ();
         _dirty = false;
+        _compact = false;
       }
     }
   }
@@ -294,7 +713,31 @@ void TF2::load_tasks ()
 {
   context.timer_load.start ();
 
-  if (! _loaded_lines)
+  // A valid snapshot replaces the parsing of the whole file.  The file stays
+  // locked until the snapshot is either used or regenerated, so that both
+  // represent the same file contents.
+  std::vector <Task> snapshot;
+  std::vector <unsigned long long> lines;
+  bool use_snapshot = false;
+  bool from_snapshot = false;
+  if (! _loaded_lines                         &&
+      _added_lines.size () == 0               &&
+      context.config.getBoolean ("snapshot")  &&
+      _file.open ())
+  {
+    use_snapshot = true;
+    if (context.config.getBoolean ("locking"))
+      _file.waitForLock ();
+
+    from_snapshot = _snapshot.load (_file, snapshot, &lines);
+    if (! from_snapshot)
+    {
+      _file.read (_lines);
+      _loaded_lines = true;
+    }
+  }
+
+  else if (! _loaded_lines)
   {
     load_lines ();
 
@@ -307,37 +750,114 @@ void TF2::load_tasks ()
   int line_number = 0;
   try
   {
-    // Reduce unnecessary allocations/copies.
-    _tasks.reserve (_lines.size ());
+    unsigned int first = _tasks.size ();
 
-    std::vector <std::string>::iterator i;
-    for (i = _lines.begin (); i != _lines.end (); ++i)
+    if (from_snapshot)
+    {
+      _tasks.reserve (snapshot.size ());
+
+      std::vector <Task>::iterator i;
+      for (i = snapshot.begin (); i != snapshot.end (); ++i)
+        load_task (*i);
+
+      if (_indexed && ! _loaded_index)
+      {
+        _loaded_index = _index.load (_file, _index_tasks, &_index_lines);
+        if (! _loaded_index)
+          build_index (first, lines);
+      }
+    }
+    else
     {
-      ++line_number;
-      Task task (*i);
+      // Reduce unnecessary allocations/copies.
+      _tasks.reserve (_lines.size ());
+
+      // Records are replayed before any task is loaded, so that the tasks get
+      // their IDs in the order of their first records, whatever followed.
+      std::vector <Task> parsed;
+      std::vector <unsigned long long> offsets;
+      std::vector <bool> cancelled;
+      std::unordered_map <std::string, unsigned int> slots;
+      unsigned long long offset = 0;
+      unsigned int obsolete = 0;
+      std::vector <std::string>::iterator i;
+      for (i = _lines.begin (); i != _lines.end (); ++i)
+      {
+        ++line_number;
+        std::unordered_map <std::string, unsigned int>::iterator slot;
+        if (isTombstone (*i))
+        {
+          // Later records of the task are loaded afresh.
+          Task tombstone (i->substr (sizeof (TOMBSTONE_KEYWORD) - 1));
+          ++obsolete;
+          if ((slot = slots.find (tombstone.get ("uuid"))) != slots.end ())
+          {
+            cancelled[slot->second] = true;
+            slots.erase (slot);
+            ++obsolete;
+          }
+
+          offset += i->length () + 1;
+          continue;
+        }
+
+        // Journal records are replayed whatever the setting, so that files
+        // written in journal mode stay readable.
+        Task task (taskRecord (*i));
+        if (isJournalRecord (*i) &&
+            (slot = slots.find (task.get ("uuid"))) != slots.end ())
+        {
+          // The record replaces its predecessor.
+          parsed[slot->second] = task;
+          offsets[slot->second] = offset;
+          ++obsolete;
+        }
+        else
+        {
+          slots[task.get ("uuid")] = parsed.size ();
+          parsed.push_back (task);
+          offsets.push_back (offset);
+          cancelled.push_back (false);
+        }
 
-      // Some tasks get an ID.
-      if (_has_ids)
+        offset += i->length () + 1;
+      }
+
+      for (unsigned int t = 0; t < parsed.size (); ++t)
       {
-        Task::status status = task.getStatus ();
-        // Completed / deleted tasks in pending.data get an ID if GC is off.
-        if (!context.run_gc ||
-            (status != Task::completed && status != Task::deleted))
-          task.id = context.tdb2.next_id ();
+        if (! cancelled[t])
+        {
+          load_task (parsed[t]);
+          lines.push_back (offsets[t]);
+        }
       }
 
-      _tasks.push_back (task);
+      // Compact the file on commit, once the obsolete records exceed the
+      // configured percentage of the tasks.
+      int limit = context.config.getInteger ("data.journal.compact");
+      if (limit > 0 &&
+          ! _read_only &&
+          obsolete * 100 > limit * (_tasks.size () - first))
+      {
+        _compact = true;
+        _dirty = true;
+      }
 
-      // Maintain mapping for ease of link/dependency resolution.
-      // Note that this mapping is not restricted by the filter, and is
-      // therefore a complete set.
-      if (task.id)
+      if (use_snapshot)
       {
-        _I2U[task.id] = task.get ("uuid");
-        _U2I[task.get ("uuid")] = task.id;
+        _snapshot.save (_file, _tasks, first, &lines);
+
+        if (_indexed)
+          build_index (first, lines);
       }
     }
 
+    if (use_snapshot)
+      _file.close ();
+
+    // Apply tasks removed since.
+    drop (_removed_uuids);
+
     if (_auto_dep_scan)
       dependency_scan ();
 
@@ -346,6 +866,9 @@ void TF2::load_tasks ()
 
   catch (const std::string& e)
   {
+    if (use_snapshot)
+      _file.close ();
+
     throw e + format (STRING_TDB2_PARSE_ERROR, _file._data, line_number);
   }
 
@@ -353,69 +876,429 @@ void TF2::load_tasks ()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TF2::load_lines ()
+// Modify in-place.
+bool TF2::store_task (const Task& task)
 {
-  if (_file.open ())
+  std::unordered_map <std::string, unsigned int>::const_iterator i;
+  if ((i = _uuid_slots.find (task.get ("uuid"))) != _uuid_slots.end ())
   {
-    if (context.config.getBoolean ("locking"))
-      _file.waitForLock ();
+    unsigned int slot = i->second;
+    int old_id = _tasks[slot].id;
 
-    _file.read (_lines);
-    _file.close ();
-    _loaded_lines = true;
-  }
-}
+    if (_tasks[slot].get_ref ("depends") != task.get_ref ("depends"))
+      _graph_current = false;
 
-////////////////////////////////////////////////////////////////////////////////
-std::string TF2::uuid (int id)
-{
-  if (! _loaded_tasks)
-  {
-    load_tasks ();
+    _tasks[slot] = task;
+    _inheritance_current = false;
+    _dirty = true;
 
-    // Apply previously added tasks.
-    std::vector <Task>::iterator i;
-    for (i = _added_tasks.begin (); i != _added_tasks.end (); ++i)
-      _tasks.push_back (*i);
-  }
+    if (task.id != old_id)
+    {
+      if (old_id > 0 && _id_slots[old_id] == (int) slot)
+        _id_slots[old_id] = -1;
+
+      index_task (slot);
+    }
 
-  std::map <int, std::string>::const_iterator i;
-  if ((i = _I2U.find (id)) != _I2U.end ())
-    return i->second;
+    return true;
+  }
 
-  return "";
+  return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-int TF2::id (const std::string& uuid)
+void TF2::load_task (Task& task)
 {
-  if (! _loaded_tasks)
+  // Some tasks get an ID.
+  if (_has_ids)
   {
-    load_tasks ();
-
-    // Apply previously added tasks.
-    std::vector <Task>::iterator i;
-    for (i = _added_tasks.begin (); i != _added_tasks.end (); ++i)
-      _tasks.push_back (*i);
+    Task::status status = task.getStatus ();
+    // Completed / deleted tasks in pending.data get an ID if GC is off.
+    if (!context.run_gc ||
+        (status != Task::completed && status != Task::deleted))
+      task.id = context.tdb2.next_id ();
   }
 
-  std::map <std::string, int>::const_iterator i;
-  if ((i = _U2I.find (uuid)) != _U2I.end ())
-    return i->second;
-
-  return 0;
+  _tasks.push_back (task);
+  index_task (_tasks.size () - 1);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TF2::has_ids ()
+// Builds and saves the index of tasks[first..], which are the tasks of the
+// locked file, at the given line offsets.
+void TF2::build_index (unsigned int first, const std::vector <unsigned long long>& lines)
 {
-  _has_ids = true;
+  _index_tasks.clear ();
+  _index_tasks.reserve (_tasks.size () - first);
+  for (unsigned int i = first; i < _tasks.size (); ++i)
+    _index_tasks.push_back (skeleton (_tasks[i]));
+
+  _index_lines = lines;
+  _loaded_index = true;
+
+  if (! _index.save (_file, _index_tasks, 0, &_index_lines))
+    _index.remove ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TF2::auto_dep_scan ()
+// Loads the index, provided it describes the current file.  The index is
+// maintained whenever the file is loaded or committed.
+bool TF2::load_index ()
 {
-  _auto_dep_scan = true;
+  if (! _loaded_index                        &&
+      _indexed                               &&
+      context.config.getBoolean ("snapshot") &&
+      _file.open ())
+  {
+    context.timer_load.start ();
+
+    if (context.config.getBoolean ("locking"))
+      _file.waitForLock ();
+
+    _loaded_index = _index.load (_file, _index_tasks, &_index_lines);
+    _file.close ();
+
+    // Apply tasks removed since.
+    drop (_removed_uuids);
+
+    context.timer_load.stop ();
+  }
+
+  return _loaded_index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const std::vector <Task>& TF2::get_index ()
+{
+  return _index_tasks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses only the given records of the index, provided the file has not
+// changed since the index was loaded.
+bool TF2::get_records (
+  const std::vector <unsigned int>& records,
+  std::vector <Task>& tasks)
+{
+  if (! _loaded_index ||
+      ! _file.open ())
+    return false;
+
+  context.timer_load.start ();
+
+  if (context.config.getBoolean ("locking"))
+    _file.waitForLock ();
+
+  bool current = _index.current (_file);
+  if (current)
+  {
+    std::ifstream in (_file._data.c_str ());
+    std::string line;
+    std::vector <unsigned int>::const_iterator r;
+    for (r = records.begin (); r != records.end (); ++r)
+    {
+      in.seekg (_index_lines[*r]);
+      if (! getline (in, line))
+      {
+        current = false;
+        break;
+      }
+
+      try
+      {
+        tasks.push_back (Task (taskRecord (line)));
+      }
+
+      catch (const std::string& e)
+      {
+        _file.close ();
+        throw e + format (STRING_TDB2_PARSE_ERROR, _file._data, (int) *r + 1);
+      }
+    }
+  }
+
+  _file.close ();
+  context.timer_load.stop ();
+
+  if (! current)
+    tasks.clear ();
+
+  return current;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the transactions of the given task from the undo file, as the lines of
+// the file would hold them, seeking to each by way of the index.
+bool TF2::get_transactions (
+  const std::string& uuid,
+  std::vector <std::string>& lines)
+{
+  lines.clear ();
+  if (! _transactional ||
+      ! _file.open ())
+    return false;
+
+  context.timer_load.start ();
+
+  if (context.config.getBoolean ("locking"))
+    _file.waitForLock ();
+
+  load_transactions ();
+
+  std::ifstream in (_file._data.c_str ());
+  for (unsigned int i = 0; i < _index_tasks.size (); ++i)
+    if (_index_tasks[i].get ("uuid") == uuid)
+      readTransaction (in, _index_lines[i], lines);
+
+  _file.close ();
+  context.timer_load.stop ();
+  return lines.size () > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads only the last transaction from the undo file.
+bool TF2::last_transaction (std::vector <std::string>& lines)
+{
+  lines.clear ();
+  if (! _transactional ||
+      ! _file.open ())
+    return false;
+
+  context.timer_load.start ();
+
+  if (context.config.getBoolean ("locking"))
+    _file.waitForLock ();
+
+  load_transactions ();
+
+  if (_index_lines.size ())
+  {
+    std::ifstream in (_file._data.c_str ());
+    readTransaction (in, _index_lines.back (), lines);
+  }
+
+  _file.close ();
+  context.timer_load.stop ();
+  return lines.size () > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Removes the last transaction from the undo file, by truncating the file
+// where the transaction begins.
+bool TF2::remove_transaction ()
+{
+  if (! _transactional ||
+      ! _file.open ())
+    return false;
+
+  if (context.config.getBoolean ("locking"))
+    _file.waitForLock ();
+
+  load_transactions ();
+
+  bool removed = false;
+  if (_index_lines.size ())
+  {
+    _indexed_size = _index_lines.back ();
+    _file.truncate (_indexed_size);
+    _index_tasks.pop_back ();
+    _index_lines.pop_back ();
+
+    if (! context.config.getBoolean ("snapshot") ||
+        ! _index.save (_file, _index_tasks, 0, &_index_lines))
+      _index.remove ();
+
+    removed = true;
+  }
+
+  _file.close ();
+
+  _loaded_lines = false;
+  _lines.clear ();
+  return removed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Brings the transaction index up to date with the locked undo file.  As the
+// file only grows between reverts, which maintain the index, an index saved
+// earlier still describes the start of the file, and only the transactions
+// appended since are scanned.
+void TF2::load_transactions ()
+{
+  bool snapshot = context.config.getBoolean ("snapshot");
+  if (! _loaded_index)
+  {
+    _indexed_size = 0;
+    if (! snapshot ||
+        ! _index.load (_file, _index_tasks, &_index_lines, &_indexed_size))
+    {
+      _index_tasks.clear ();
+      _index_lines.clear ();
+      _indexed_size = 0;
+    }
+
+    _loaded_index = true;
+  }
+
+  unsigned long long size = _file.size ();
+  if (_indexed_size == size)
+    return;
+
+  // Verify that the indexed part of the file ends on a line boundary, and that
+  // the last indexed transaction is where the index says, otherwise the file
+  // was changed by other means, and is scanned afresh.
+  std::ifstream in (_file._data.c_str ());
+  std::string line;
+  bool valid = _indexed_size < size;
+  if (valid && _indexed_size > 0)
+  {
+    char last = '\0';
+    in.seekg (_indexed_size - 1);
+    valid = in.get (last) && last == '\n';
+  }
+
+  if (valid && _index_lines.size ())
+  {
+    in.seekg (_index_lines.back ());
+    valid = getline (in, line) && line.compare (0, 5, "time ") == 0;
+  }
+
+  if (! valid)
+  {
+    _index_tasks.clear ();
+    _index_lines.clear ();
+    _indexed_size = 0;
+  }
+
+  // Only complete lines are indexed.
+  in.clear ();
+  in.seekg (_indexed_size);
+  unsigned long long offset = _indexed_size;
+  while (getline (in, line) && ! in.eof ())
+  {
+    index_transaction (line, offset);
+    offset += line.length () + 1;
+  }
+
+  _indexed_size = offset;
+  if (snapshot && _indexed_size == size)
+    _index.save (_file, _index_tasks, 0, &_index_lines);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A transaction is indexed by the offset of its time line, and the UUID of its
+// new task.
+void TF2::index_transaction (const std::string& line, unsigned long long offset)
+{
+  if (line.compare (0, 5, "time ") == 0)
+  {
+    _index_tasks.push_back (Task ());
+    _index_lines.push_back (offset);
+  }
+  else if ((line.compare (0, 4, "new ") == 0 ||
+            line.compare (0, 6, "delta ") == 0) &&
+           _index_tasks.size ())
+  {
+    std::string uuid = transactionUUID (line);
+    if (uuid != "")
+      _index_tasks.back ().set ("uuid", uuid);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Static.
+bool TF2::indexed_attribute (const std::string& name)
+{
+  for (unsigned int i = 0; i < NUM_INDEXED_ATTRIBUTES; ++i)
+    if (name == indexed_attributes[i])
+      return true;
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::load_lines ()
+{
+  if (_file.open ())
+  {
+    if (context.config.getBoolean ("locking"))
+      _file.waitForLock ();
+
+    _file.read (_lines);
+    _file.close ();
+    _loaded_lines = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string TF2::uuid (int id)
+{
+  if (! _loaded_tasks)
+  {
+    load_tasks ();
+
+    // Apply previously added tasks.
+    std::vector <Task>::iterator i;
+    for (i = _added_tasks.begin (); i != _added_tasks.end (); ++i)
+    {
+      _tasks.push_back (*i);
+      index_task (_tasks.size () - 1);
+    }
+  }
+
+  if (id > 0 &&
+      id < (int) _id_slots.size () &&
+      _id_slots[id] != -1)
+    return _tasks[_id_slots[id]].get ("uuid");
+
+  return "";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int TF2::id (const std::string& uuid)
+{
+  if (! _loaded_tasks)
+  {
+    load_tasks ();
+
+    // Apply previously added tasks.
+    std::vector <Task>::iterator i;
+    for (i = _added_tasks.begin (); i != _added_tasks.end (); ++i)
+    {
+      _tasks.push_back (*i);
+      index_task (_tasks.size () - 1);
+    }
+  }
+
+  std::unordered_map <std::string, unsigned int>::const_iterator i;
+  if ((i = _uuid_slots.find (uuid)) != _uuid_slots.end ())
+    return _tasks[i->second].id;
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::has_ids ()
+{
+  _has_ids = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::auto_dep_scan ()
+{
+  _auto_dep_scan = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::indexed ()
+{
+  _indexed = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::transactional ()
+{
+  _transactional = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -426,63 +1309,386 @@ void TF2::clear ()
   _dirty           = false;
   _loaded_tasks    = false;
   _loaded_lines    = false;
+  _loaded_index    = false;
+  _compact         = false;
+
+  // Note that these are deliberately not cleared.
+  //_file._data      = "";
+  //_has_ids         = false;
+  //_auto_dep_scan   = false;
+
+  _tasks.clear ();
+  _added_tasks.clear ();
+  _relocated_tasks.clear ();
+  _replaced_tasks.clear ();
+  _removed_uuids.clear ();
+  _modified_tasks.clear ();
+  _lines.clear ();
+  _added_lines.clear ();
+  _index_tasks.clear ();
+  _index_lines.clear ();
+  _uuid_slots.clear ();
+  _id_slots.clear ();
+  _graph_current = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rewrites the file on commit, without tombstones, journal records and the
+// records they replace.  Returns the number of lines that are dropped.
+int TF2::compact ()
+{
+  // The lines are read first, so that the tasks are parsed from them rather
+  // than from the snapshot.  Tasks not yet written are not in the lines.
+  int lines = get_lines ().size () - _added_lines.size ();
+  int tasks = get_tasks ().size () - _added_tasks.size () - _relocated_tasks.size ();
+
+  _compact = true;
+  _dirty = true;
+  return lines - tasks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Discards the snapshot and index, for when the file is written by other means.
+void TF2::remove_snapshots ()
+{
+  _snapshot.remove ();
+  _index.remove ();
+  _loaded_index = false;
+  _index_tasks.clear ();
+  _index_lines.clear ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rebuilds the UUID and ID indexes after _tasks was replaced wholesale.
+void TF2::reindex ()
+{
+  _uuid_slots.clear ();
+  _id_slots.clear ();
+  _graph_current = false;
+
+  for (unsigned int slot = 0; slot < _tasks.size (); ++slot)
+    index_task (slot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Removes tasks from the loaded tasks and index, in one pass over each, and
+// reindexes once.
+void TF2::drop (const std::vector <std::string>& uuids)
+{
+  if (! uuids.size ())
+    return;
+
+  std::unordered_set <std::string> dropped (uuids.begin (), uuids.end ());
+
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < _tasks.size (); ++i)
+  {
+    if (dropped.count (_tasks[i].get_ref ("uuid")))
+      continue;
+
+    if (kept != i)
+      _tasks[kept] = _tasks[i];
+
+    ++kept;
+  }
+
+  if (kept != _tasks.size ())
+  {
+    _tasks.resize (kept);
+    reindex ();
+  }
+
+  kept = 0;
+  for (unsigned int i = 0; i < _index_tasks.size (); ++i)
+  {
+    if (dropped.count (_index_tasks[i].get_ref ("uuid")))
+      continue;
+
+    if (kept != i)
+    {
+      _index_tasks[kept] = _index_tasks[i];
+      _index_lines[kept] = _index_lines[i];
+    }
+
+    ++kept;
+  }
+
+  _index_tasks.resize (kept);
+  _index_lines.resize (kept);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Maintain mapping for ease of link/dependency resolution.  Note that this
+// mapping is not restricted by the filter, and is therefore a complete set.
+// The first occurrence of a UUID or ID wins, as a linear scan would find it.
+void TF2::index_task (unsigned int slot)
+{
+  const Task& task = _tasks[slot];
+  _uuid_slots.insert (std::pair <std::string, unsigned int> (task.get ("uuid"), slot));
+
+  if (task.id > 0)
+  {
+    if (task.id >= (int) _id_slots.size ())
+      _id_slots.resize (task.id + 1, -1);
+
+    if (_id_slots[task.id] == -1)
+      _id_slots[task.id] = slot;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Builds the dependency graph of the loaded tasks: for each slot, the slots of
+// the tasks it depends on, and for each UUID, the slots of the tasks that
+// depend on it, whether or not that UUID is loaded.  Edges are kept regardless
+// of status, which is checked as the graph is queried, so the graph is only
+// rebuilt when tasks are added or removed, or their dependencies change.
+void TF2::build_graph ()
+{
+  _blocking_slots.assign (_tasks.size (), std::vector <unsigned int> ());
+  _blocked_slots.clear ();
+  _dependency_order.clear ();
+
+  std::vector <unsigned int> pending (_tasks.size (), 0);
+  std::vector <std::string> deps;
+  for (unsigned int slot = 0; slot < _tasks.size (); ++slot)
+  {
+    if (! _tasks[slot].has ("depends"))
+      continue;
+
+    _tasks[slot].getDependencies (deps);
+
+    std::vector <unsigned int>& blocking = _blocking_slots[slot];
+    std::vector <std::string>::iterator d;
+    for (d = deps.begin (); d != deps.end (); ++d)
+    {
+      std::vector <unsigned int>& blocked = _blocked_slots[*d];
+      if (blocked.empty () || blocked.back () != slot)
+        blocked.push_back (slot);
+
+      std::unordered_map <std::string, unsigned int>::const_iterator found;
+      if ((found = _uuid_slots.find (*d)) != _uuid_slots.end ())
+        blocking.push_back (found->second);
+    }
+
+    std::sort (blocking.begin (), blocking.end ());
+    blocking.erase (std::unique (blocking.begin (), blocking.end ()), blocking.end ());
+    pending[slot] = blocking.size ();
+  }
+
+  // Topological order, with each task after those it depends on.  Tasks on a
+  // cycle, which the 'depends' checks should prevent, come last.
+  std::vector <bool> placed (_tasks.size (), false);
+  _dependency_order.reserve (_tasks.size ());
+  for (unsigned int slot = 0; slot < _tasks.size (); ++slot)
+  {
+    if (pending[slot] == 0)
+    {
+      _dependency_order.push_back (slot);
+      placed[slot] = true;
+    }
+  }
+
+  for (unsigned int next = 0; next < _dependency_order.size (); ++next)
+  {
+    unsigned int slot = _dependency_order[next];
+    const std::string& uuid = _tasks[slot].get_ref ("uuid");
+    if (_uuid_slots[uuid] != slot)
+      continue;
+
+    std::unordered_map <std::string, std::vector <unsigned int>>::const_iterator blocked;
+    if ((blocked = _blocked_slots.find (uuid)) == _blocked_slots.end ())
+      continue;
+
+    std::vector <unsigned int>::const_iterator b;
+    for (b = blocked->second.begin (); b != blocked->second.end (); ++b)
+    {
+      if (--pending[*b] == 0)
+      {
+        _dependency_order.push_back (*b);
+        placed[*b] = true;
+      }
+    }
+  }
+
+  for (unsigned int slot = 0; slot < _tasks.size (); ++slot)
+    if (! placed[slot])
+      _dependency_order.push_back (slot);
+
+  _graph_current = true;
+  _inheritance_current = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Urgency inherited by each blocking task, computed in reverse dependency
+// order so that each task only sums the already known values of the tasks it
+// blocks, instead of recursing along every chain for every task.  On a cycle,
+// the recursion never ended; here a task just inherits nothing yet unknown.
+void TF2::build_inheritance ()
+{
+  _inherited.assign (_tasks.size (), 0.0);
+
+  std::vector <unsigned int>::reverse_iterator slot;
+  for (slot = _dependency_order.rbegin (); slot != _dependency_order.rend (); ++slot)
+    if (_tasks[*slot].is_blocking)
+      _inherited[*slot] = inherit_from (_tasks[*slot].get_ref ("uuid"));
+
+  _inheritance_current = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+float TF2::inherit_from (const std::string& uuid) const
+{
+  float v = 0.0;
+
+  std::unordered_map <std::string, std::vector <unsigned int>>::const_iterator found;
+  if ((found = _blocked_slots.find (uuid)) == _blocked_slots.end ())
+    return v;
+
+  std::vector <unsigned int>::const_iterator slot;
+  for (slot = found->second.begin (); slot != found->second.end (); ++slot)
+  {
+    const Task& blocked = _tasks[*slot];
+    Task::status status = blocked.getStatus ();
+    if (status != Task::pending &&
+        status != Task::waiting)
+      continue;
+
+    // urgency_blocked, _blocking, _project and _tags left out.
+    v += blocked.urgency_active ();
+    v += blocked.urgency_age ();
+    v += blocked.urgency_annotations ();
+    v += blocked.urgency_due ();
+    v += blocked.urgency_next ();
+    v += blocked.urgency_priority ();
+    v += blocked.urgency_scheduled ();
+    v += blocked.urgency_waiting ();
+
+    // Inherit from all parent tasks in the dependency chain.
+    v += _inherited[*slot];
+  }
+
+  return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The pending and waiting tasks that depend on the given UUID, in file order.
+void TF2::get_blocked (const std::string& uuid, std::vector <Task>& blocked)
+{
+  if (! _loaded_tasks)
+    load_tasks ();
+
+  {
+    std::lock_guard <std::mutex> lock (_graph_mutex);
+    if (! _graph_current)
+      build_graph ();
+  }
+
+  std::unordered_map <std::string, std::vector <unsigned int>>::const_iterator found;
+  if ((found = _blocked_slots.find (uuid)) == _blocked_slots.end ())
+    return;
+
+  std::vector <unsigned int>::const_iterator slot;
+  for (slot = found->second.begin (); slot != found->second.end (); ++slot)
+  {
+    Task::status status = _tasks[*slot].getStatus ();
+    if (status == Task::pending ||
+        status == Task::waiting)
+      blocked.push_back (_tasks[*slot]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The pending and waiting tasks that the given task depends on, in file order.
+// The task need not be the loaded one, as during a modification.
+void TF2::get_blocking (const Task& task, std::vector <Task>& blocking)
+{
+  if (! task.has ("depends"))
+    return;
+
+  if (! _loaded_tasks)
+    load_tasks ();
+
+  std::vector <std::string> deps;
+  task.getDependencies (deps);
+
+  std::vector <unsigned int> slots;
+  std::vector <std::string>::iterator d;
+  for (d = deps.begin (); d != deps.end (); ++d)
+  {
+    std::unordered_map <std::string, unsigned int>::const_iterator found;
+    if ((found = _uuid_slots.find (*d)) != _uuid_slots.end ())
+      slots.push_back (found->second);
+  }
+
+  std::sort (slots.begin (), slots.end ());
+  slots.erase (std::unique (slots.begin (), slots.end ()), slots.end ());
+
+  std::vector <unsigned int>::iterator slot;
+  for (slot = slots.begin (); slot != slots.end (); ++slot)
+  {
+    Task::status status = _tasks[*slot].getStatus ();
+    if (status == Task::pending ||
+        status == Task::waiting)
+      blocking.push_back (_tasks[*slot]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Slots of the loaded tasks, each after the tasks it depends on.
+const std::vector <unsigned int>& TF2::dependency_order ()
+{
+  if (! _loaded_tasks)
+    load_tasks ();
+
+  std::lock_guard <std::mutex> lock (_graph_mutex);
+  if (! _graph_current)
+    build_graph ();
+
+  return _dependency_order;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The urgency a task inherits from the pending and waiting tasks it blocks,
+// and from those they block in turn.
+float TF2::inherited_urgency (const std::string& uuid)
+{
+  if (! _loaded_tasks)
+    load_tasks ();
 
-  // Note that these are deliberately not cleared.
-  //_file._data      = "";
-  //_has_ids         = false;
-  //_auto_dep_scan   = false;
+  std::lock_guard <std::mutex> lock (_graph_mutex);
+  if (! _graph_current)
+    build_graph ();
 
-  _tasks.clear ();
-  _added_tasks.clear ();
-  _modified_tasks.clear ();
-  _lines.clear ();
-  _added_lines.clear ();
-  _I2U.clear ();
-  _U2I.clear ();
+  if (! _inheritance_current)
+    build_inheritance ();
+
+  return inherit_from (uuid);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// For any task that has depenencies, follow the chain of dependencies until the
-// end.  Along the way, update the Task::is_blocked and Task::is_blocking data
-// cache.
+// Update the Task::is_blocked and Task::is_blocking data cache from the
+// dependency graph.
 void TF2::dependency_scan ()
 {
-  // Iterate and modify TDB2 in-place.  Don't do this at home.
-  std::vector <Task>::iterator left;
-  for (left  = _tasks.begin ();
-       left != _tasks.end ();
-       ++left)
+  build_graph ();
+
+  for (unsigned int left = 0; left < _tasks.size (); ++left)
   {
-    if (left->has ("depends"))
+    std::vector <unsigned int>::iterator right;
+    for (right  = _blocking_slots[left].begin ();
+         right != _blocking_slots[left].end ();
+         ++right)
     {
-      std::vector <std::string> deps;
-      left->getDependencies (deps);
-
-      std::vector <std::string>::iterator d;
-      for (d = deps.begin (); d != deps.end (); ++d)
+      // GC hasn't run yet, check both tasks for their current status
+      Task::status lstatus = _tasks[left].getStatus ();
+      Task::status rstatus = _tasks[*right].getStatus ();
+      if (lstatus != Task::completed &&
+          lstatus != Task::deleted &&
+          rstatus != Task::completed &&
+          rstatus != Task::deleted)
       {
-        std::vector <Task>::iterator right;
-        for (right  = _tasks.begin ();
-             right != _tasks.end ();
-             ++right)
-        {
-          if (right->get ("uuid") == *d)
-          {
-            // GC hasn't run yet, check both tasks for their current status
-            Task::status lstatus = left->getStatus ();
-            Task::status rstatus = right->getStatus ();
-            if (lstatus != Task::completed &&
-                lstatus != Task::deleted &&
-                rstatus != Task::completed &&
-                rstatus != Task::deleted)
-            {
-              left->is_blocked = true;
-              right->is_blocking = true;
-            }
-
-            break;
-          }
-        }
+        _tasks[left].is_blocked = true;
+        _tasks[*right].is_blocking = true;
       }
     }
   }
@@ -542,6 +1748,8 @@ TDB2::TDB2 ()
   // Indicate that dependencies should be automatically scanned on startup,
   // setting Task::is_blocked and Task::is_blocking accordingly.
   pending.auto_dep_scan ();
+  completed.indexed ();
+  undo.transactional ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -587,6 +1795,36 @@ void TDB2::add (Task& task, bool add_to_backlog /* = true */)
   update (uuid, task, add_to_backlog, true);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Adds many tasks at once, as by import.  The hooks are called once for all of
+// them, and the UUIDs are checked against each other as well as the pending
+// tasks.
+void TDB2::add (std::vector <Task>& tasks)
+{
+  std::unordered_set <std::string> uuids;
+  uuids.reserve (tasks.size ());
+
+  std::vector <Task>::iterator task;
+  for (task = tasks.begin (); task != tasks.end (); ++task)
+  {
+    task->validate (true);
+    std::string uuid = task->get ("uuid");
+
+    if (! uuids.insert (uuid).second ||
+        ! verifyUniqueUUID (uuid))
+      throw format (STRING_TDB2_UUID_NOT_UNIQUE, uuid);
+  }
+
+  context.hooks.onAdd (tasks);
+
+  // Avoid repeated reallocation of the loaded tasks.
+  pending.get_tasks ();
+  pending._tasks.reserve (pending._tasks.size () + tasks.size ());
+
+  for (task = tasks.begin (); task != tasks.end (); ++task)
+    update (task->get ("uuid"), *task, true, true);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void TDB2::modify (Task& task, bool add_to_backlog /* = true */)
 {
@@ -627,17 +1865,53 @@ void TDB2::update (
     }
 
     // Update the task, wherever it is.
+    TF2* file = &pending;
     if (!pending.modify_task (task))
+    {
+      file = &completed;
       completed.modify_task (task);
+    }
 
-    // time <time>
-    // old <task>
-    // new <task>
-    // ---
+    // Only the changed attributes are recorded:
+    //   time <time>
+    //   delta <new values> <old values>
+    //   ---
+    // or, with undo.delta off, the whole task:
+    //   time <time>
+    //   old <task>
+    //   new <task>
+    //   ---
     undo.add_line ("time " + Date ().toEpochString () + "\n");
-    undo.add_line ("old " + original.composeF4 () + "\n");
-    undo.add_line ("new " + task.composeF4 () + "\n");
+    if (context.config.getBoolean ("undo.delta"))
+      undo.add_line ("delta " + composeDelta (original, task) + "\n");
+    else
+    {
+      undo.add_line ("old " + original.composeF4 () + "\n");
+      undo.add_line ("new " + task.composeF4 () + "\n");
+    }
     undo.add_line ("---\n");
+
+    // Remember the modification, so that the on-modify-batch hooks can amend
+    // it before the commit.
+    if (add_to_backlog &&
+        context.hooks.has ("on-modify-batch"))
+    {
+      std::unordered_map <std::string, unsigned int>::iterator slot = _modification_slots.find (uuid);
+      if (slot == _modification_slots.end ())
+      {
+        Modification m;
+        m.original = original;
+        slot = _modification_slots.insert (std::make_pair (uuid, _modifications.size ())).first;
+        _modifications.push_back (m);
+      }
+
+      Modification& m = _modifications[slot->second];
+      m.previous     = original;
+      m.file         = file;
+      m.modified     = file->_modified_tasks.size () - 1;
+      m.undo_line    = undo._added_lines.size () - 2;
+      m.backlog_line = backlog._added_lines.size ();
+    }
   }
   else
   {
@@ -675,16 +1949,23 @@ void TDB2::commit ()
   signal (SIGUSR1,   SIG_IGN);
   signal (SIGUSR2,   SIG_IGN);
 
+  batch_modifications ();
+
   dump ();
   context.timer_commit.start ();
 
   gather_changes ();
 
+  bool undo_appended = undo._added_lines.size () > 0;
+
   pending.commit ();
   completed.commit ();
   undo.commit ();
   backlog.commit ();
 
+  if (undo_appended)
+    rotate_undo ();
+
   // Restore signal handling.
   signal (SIGHUP,    SIG_DFL);
   signal (SIGINT,    SIG_DFL);
@@ -697,6 +1978,60 @@ void TDB2::commit ()
   context.timer_commit.stop ();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// All tasks modified by the command go through the on-modify-batch hooks at
+// once.  Whatever the hooks change is folded into the last modification of
+// each task, so that it is undone along with it.
+void TDB2::batch_modifications ()
+{
+  if (! _modifications.size ())
+    return;
+
+  std::vector <Task> before;
+  std::vector <Task> after;
+  before.reserve (_modifications.size ());
+  after.reserve (_modifications.size ());
+
+  std::vector <Modification>::iterator m;
+  for (m = _modifications.begin (); m != _modifications.end (); ++m)
+  {
+    Task task;
+    get (m->original.get ("uuid"), task);
+    before.push_back (m->original);
+    after.push_back (task);
+  }
+
+  std::vector <std::string> current;
+  current.reserve (after.size ());
+  std::vector <Task>::iterator task;
+  for (task = after.begin (); task != after.end (); ++task)
+    current.push_back (task->composeF4 ());
+
+  context.hooks.onModify (before, after);
+
+  bool delta = context.config.getBoolean ("undo.delta");
+  for (unsigned int i = 0; i < after.size (); ++i)
+  {
+    Task& task = after[i];
+    task.validate (false);
+    if (task.composeF4 () == current[i])
+      continue;
+
+    task.setAsNow ("modified");
+    _modifications[i].file->replace_modified (_modifications[i].modified, task);
+
+    if (delta)
+      undo.replace_line (_modifications[i].undo_line, "delta " + composeDelta (_modifications[i].previous, task) + "\n");
+    else
+      undo.replace_line (_modifications[i].undo_line, "new " + task.composeF4 () + "\n");
+
+    backlog.replace_line (_modifications[i].backlog_line, task.composeJSON () + "\n");
+  }
+
+  _modifications.clear ();
+  _modification_slots.clear ();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void TDB2::gather_changes ()
 {
@@ -724,8 +2059,12 @@ void TDB2::get_changes (std::vector <Task>& changes)
 ////////////////////////////////////////////////////////////////////////////////
 void TDB2::revert ()
 {
-  // Extract the details of the last txn, and roll it back.
-  std::vector <std::string> u = undo.get_lines ();
+  // Extract the details of the last txn, and roll it back.  Only that txn is
+  // read from the undo file.
+  std::vector <std::string> u;
+  if (! undo.last_transaction (u) &&
+      restore_undo ())
+    undo.last_transaction (u);
   std::string uuid;
   std::string when;
   std::string current;
@@ -772,22 +2111,25 @@ void TDB2::revert ()
     //   - erase from completed
     //   - if in backlog, erase, else cannot undo
 
-    // Modify other data files accordingly.
-    std::vector <std::string> p = pending.get_lines ();
-    revert_pending (p, uuid, current, prior);
-
-    std::vector <std::string> c = completed.get_lines ();
-    revert_completed (p, c, uuid, current, prior);
-
+    // The backlog decides whether the txn can be undone at all, so it goes
+    // first.
     std::vector <std::string> b = backlog.get_lines ();
-    revert_backlog (b, uuid, current, prior);
+    bool rewrite_backlog = revert_backlog (b, uuid, current, prior);
+
+    // Patch only the affected task in the other data files, which are written
+    // like any other change.  completed.data is searched first, because its
+    // index avoids loading it.
+    if (! revert_completed (uuid, current, prior))
+      revert_pending (uuid, current, prior);
 
     // Commit.  If processing makes it this far with no exceptions, then we're
-    // done.
-    File::write (undo._file._data, u);
-    File::write (pending._file._data, p);
-    File::write (completed._file._data, c);
-    File::write (backlog._file._data, b);
+    // done.  The txn is removed last, so that an interrupted undo can be
+    // repeated.
+    if (rewrite_backlog)
+      File::write (backlog._file._data, b);
+
+    commit ();
+    undo.remove_transaction ();
   }
   else
     std::cout << STRING_CMD_CONFIG_NO_CHANGE << "\n";
@@ -807,6 +2149,36 @@ void TDB2::revert_undo (
   // pop last tx
   u.pop_back (); // separator.
 
+  // A delta holds only the changed attributes, which are applied in reverse
+  // to the current state of the task.
+  if (u.back ().compare (0, 6, "delta ") == 0)
+  {
+    Task after;
+    Task before;
+    parseDelta (u.back ().substr (6), before, after);
+    u.pop_back ();
+    when = u.back ().substr (5);
+    u.pop_back ();
+
+    uuid = after.get ("uuid");
+    Task task;
+    if (uuid == "" ||
+        ! revert_current (uuid, task))
+      throw std::string (STRING_TDB2_MISSING_UUID);
+
+    current = task.composeF4 ();
+
+    Task::iterator att;
+    for (att = after.begin (); att != after.end (); ++att)
+      task.erase (att->first);
+
+    for (att = before.begin (); att != before.end (); ++att)
+      task[att->first] = att->second;
+
+    prior = task.composeF4 ();
+    return;
+  }
+
   current = u.back ().substr (4);
   u.pop_back ();
 
@@ -832,93 +2204,124 @@ void TDB2::revert_undo (
     throw std::string (STRING_TDB2_MISSING_UUID);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Reads the task as it is now, using the completed.data index rather than
+// loading that file.
+bool TDB2::revert_current (const std::string& uuid, Task& task)
+{
+  if (completed.load_index ())
+  {
+    const std::vector <Task>& index = completed.get_index ();
+    for (unsigned int i = 0; i < index.size (); ++i)
+    {
+      if (index[i].get ("uuid") == uuid)
+      {
+        std::vector <unsigned int> records (1, i);
+        std::vector <Task> tasks;
+        if (completed.get_records (records, tasks))
+        {
+          task = tasks[0];
+          return true;
+        }
+
+        break;
+      }
+    }
+  }
+
+  return get (uuid, task);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void TDB2::revert_pending (
-  std::vector <std::string>& p,
   const std::string& uuid,
   const std::string& current,
   const std::string& prior)
 {
-  std::string uuid_att = "uuid:\"" + uuid + "\"";
-
   // is 'current' in pending?
-  std::vector <std::string>::iterator task;
-  for (task = p.begin (); task != p.end (); ++task)
+  Task task;
+  if (pending.get (uuid, task))
   {
-    if (task->find (uuid_att) != std::string::npos)
-    {
-      context.debug ("TDB::revert - task found in pending.data");
+    context.debug ("TDB::revert - task found in pending.data");
 
-      // Either revert if there was a prior state, or remove the task.
-      if (prior != "")
-      {
-        *task = prior;
-        std::cout << STRING_TDB2_REVERTED << "\n";
-      }
-      else
-      {
-        p.erase (task);
-        std::cout << STRING_TDB2_REMOVED << "\n";
-      }
-
-      break;
+    // Either revert if there was a prior state, or remove the task.
+    if (prior != "")
+    {
+      Task restored (prior);
+      restored.id = task.id;
+      pending.replace_task (restored);
+      std::cout << STRING_TDB2_REVERTED << "\n";
+    }
+    else
+    {
+      pending.remove_task (task);
+      std::cout << STRING_TDB2_REMOVED << "\n";
     }
   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TDB2::revert_completed (
-  std::vector <std::string>& p,
-  std::vector <std::string>& c,
+bool TDB2::revert_completed (
   const std::string& uuid,
   const std::string& current,
   const std::string& prior)
 {
-  std::string uuid_att = "uuid:\"" + uuid + "\"";
+  // is 'current' in completed?  The index answers without loading the file.
+  bool found = false;
+  if (completed.load_index ())
+  {
+    const std::vector <Task>& index = completed.get_index ();
+    std::vector <Task>::const_iterator i;
+    for (i = index.begin (); i != index.end () && ! found; ++i)
+      found = i->get ("uuid") == uuid;
+  }
+  else
+    found = completed.has (uuid);
 
-  // is 'current' in completed?
-  std::vector <std::string>::iterator task;
-  for (task = c.begin (); task != c.end (); ++task)
+  if (found)
   {
-    if (task->find (uuid_att) != std::string::npos)
-    {
-      context.debug ("TDB::revert_completed - task found in completed.data");
+    context.debug ("TDB::revert_completed - task found in completed.data");
+    Task task (current);
 
-      // Either revert if there was a prior state, or remove the task.
-      if (prior != "")
+    // Either revert if there was a prior state, or remove the task.
+    if (prior != "")
+    {
+      Task restored (prior);
+      Task::status status = restored.getStatus ();
+      if (status == Task::pending ||
+          status == Task::waiting ||
+          status == Task::recurring)
       {
-        *task = prior;
-        if (task->find ("status:\"pending\"")   != std::string::npos ||
-            task->find ("status:\"waiting\"")   != std::string::npos ||
-            task->find ("status:\"recurring\"") != std::string::npos)
-        {
-          c.erase (task);
-          p.push_back (prior);
-          std::cout << STRING_TDB2_REVERTED << "\n";
-          context.debug ("TDB::revert_completed - task belongs in pending.data");
-        }
-        else
-        {
-          std::cout << STRING_TDB2_REVERTED << "\n";
-          context.debug ("TDB::revert_completed - task belongs in completed.data");
-        }
+        completed.remove_task (task);
+        pending.relocate_task (restored);
+        std::cout << STRING_TDB2_REVERTED << "\n";
+        context.debug ("TDB::revert_completed - task belongs in pending.data");
       }
       else
       {
-        c.erase (task);
-
+        completed.get_tasks ();
+        completed.replace_task (restored);
         std::cout << STRING_TDB2_REVERTED << "\n";
-        context.debug ("TDB::revert_completed - task removed");
+        context.debug ("TDB::revert_completed - task belongs in completed.data");
       }
+    }
+    else
+    {
+      completed.remove_task (task);
 
-      std::cout << STRING_TDB2_UNDO_COMPLETE << "\n";
-      break;
+      std::cout << STRING_TDB2_REVERTED << "\n";
+      context.debug ("TDB::revert_completed - task removed");
     }
+
+    std::cout << STRING_TDB2_UNDO_COMPLETE << "\n";
   }
+
+  return found;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TDB2::revert_backlog (
+// Returns true if the backlog needs to be rewritten, rather than appended to.
+bool TDB2::revert_backlog (
   std::vector <std::string>& b,
   const std::string& uuid,
   const std::string& current,
@@ -926,14 +2329,12 @@ void TDB2::revert_backlog (
 {
   std::string uuid_att = "\"uuid\":\"" + uuid + "\"";
 
-  bool found = false;
   std::vector <std::string>::reverse_iterator task;
   for (task = b.rbegin (); task != b.rend (); ++task)
   {
     if (task->find (uuid_att) != std::string::npos)
     {
       context.debug ("TDB::revert_backlog - task found in backlog.data");
-      found = true;
 
       // If this is a new task (no prior), then just remove it from the backlog.
       if (current != "" && prior == "")
@@ -941,21 +2342,158 @@ void TDB2::revert_backlog (
         // Yes, this is what is needed, when you want to erase using a reverse
         // iterator.
         b.erase ((++task).base ());
+        return true;
       }
 
       // If this is a modification of some kind, add the prior to the backlog.
-      else
-      {
-        Task t (prior);
-        b.push_back (t.composeJSON ());
-      }
+      Task t (prior);
+      backlog.add_line (t.composeJSON () + "\n");
+      return false;
+    }
+  }
 
-      break;
+  throw std::string (STRING_TDB2_UNDO_SYNCED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Moves undo.data aside as a segment once it grows beyond the configured size,
+// so that undo and info only read a bounded file.  Segments are optionally
+// compressed, and deleted once older than the retention period.
+void TDB2::rotate_undo ()
+{
+  long long limit = context.config.getInteger ("undo.segment.size");
+  if (limit <= 0 ||
+      (long long) undo._file.size () <= limit)
+    return;
+
+  File file (undo._file._data);
+  if (! file.open ())
+    return;
+
+  if (context.config.getBoolean ("locking"))
+    file.waitForLock ();
+
+  // Another process may have started a new undo.data while this one waited.
+  std::map <int, std::string> segments = undoSegments (_location);
+  if ((long long) file.size () > limit)
+  {
+    int next = segments.size () ? segments.rbegin ()->first + 1 : 1;
+    std::string segment = _location + "/undo." + format (next) + ".data";
+    if (! rename (file._data.c_str (), segment.c_str ()))
+    {
+      segments[next] = segment;
+      undo.remove_snapshots ();
+      context.debug ("TDB2::rotate_undo - started " + segment);
     }
   }
 
-  if (!found)
-    throw std::string (STRING_TDB2_UNDO_SYNCED);
+  file.close ();
+
+#ifdef HAVE_LIBZ
+  if (context.config.getBoolean ("undo.compress"))
+  {
+    std::map <int, std::string>::iterator s;
+    for (s = segments.begin (); s != segments.end (); ++s)
+      if (s->second.substr (s->second.length () - 3) != ".gz" &&
+          compressSegment (s->second))
+        s->second += ".gz";
+  }
+#endif
+
+  int retention = context.config.getInteger ("undo.retention");
+  if (retention > 0)
+  {
+    time_t cutoff = time (NULL) - retention * 86400;
+    std::map <int, std::string>::iterator s;
+    for (s = segments.begin (); s != segments.end (); ++s)
+      if (File (s->second).mtime () < cutoff)
+        File::remove (s->second);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Brings back the latest undo segment as undo.data, once every transaction in
+// undo.data is undone.
+bool TDB2::restore_undo ()
+{
+  std::map <int, std::string> segments = undoSegments (_location);
+  if (! segments.size ())
+    return false;
+
+  File file (undo._file._data);
+  if (! file.open ())
+    return false;
+
+  if (context.config.getBoolean ("locking"))
+    file.waitForLock ();
+
+  // The segment is copied in, rather than renamed over undo.data, so that the
+  // lock held on undo.data covers the restored contents.
+  bool restored = false;
+  std::string segment = segments.rbegin ()->second;
+  if (file.size () == 0)
+  {
+    std::string data;
+    if (segment.substr (segment.length () - 3) != ".gz")
+      restored = File::read (segment, data);
+#ifdef HAVE_LIBZ
+    else
+      restored = decompressSegment (segment, data);
+#endif
+
+    restored = restored            &&
+               file.replace (data) &&
+               File::remove (segment);
+  }
+
+  file.close ();
+
+  if (restored)
+  {
+    undo.remove_snapshots ();
+    context.debug ("TDB2::restore_undo - restored " + segment);
+  }
+
+  return restored;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Counts the undo transactions in undo.data and every segment, and the bytes
+// they all occupy on disk.  Compressed segments are only counted when zlib
+// is available to read them.
+void TDB2::undo_statistics (int& transactions, size_t& bytes)
+{
+  transactions = 0;
+  bytes = undo._file.size ();
+
+  std::vector <std::string> lines = undo.get_lines ();
+  std::vector <std::string>::iterator line;
+  for (line = lines.begin (); line != lines.end (); ++line)
+    if (*line == "---")
+      ++transactions;
+
+  std::map <int, std::string> segments = undoSegments (_location);
+  std::map <int, std::string>::iterator s;
+  for (s = segments.begin (); s != segments.end (); ++s)
+  {
+    bytes += File (s->second).size ();
+
+    std::string data;
+    if (s->second.substr (s->second.length () - 3) != ".gz")
+      File::read (s->second, data);
+#ifdef HAVE_LIBZ
+    else if (! decompressSegment (s->second, data))
+      data = "";
+#endif
+
+    std::string::size_type i = 0;
+    while ((i = data.find ("---\n", i)) != std::string::npos)
+    {
+      if (i == 0 || data[i - 1] == '\n')
+        ++transactions;
+      i += 4;
+    }
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -995,7 +2533,7 @@ void TDB2::show_diff (
       Task before (prior);
 
       std::vector <std::string> beforeAtts;
-      std::map <std::string, std::string>::iterator att;
+      Task::const_iterator att;
       for (att = before.begin (); att != before.end (); ++att)
         beforeAtts.push_back (att->first);
 
@@ -1042,7 +2580,7 @@ void TDB2::show_diff (
     else
     {
       int row;
-      std::map <std::string, std::string>::iterator att;
+      Task::const_iterator att;
       for (att = after.begin (); att != after.end (); ++att)
       {
         row = view.addRow ();
@@ -1180,6 +2718,39 @@ void TDB2::show_diff (
   }
 }
 
+#ifdef HAVE_LIBPTHREAD
+////////////////////////////////////////////////////////////////////////////////
+// Loads the tasks of a file in a separate thread, keeping any error for the
+// thread that joins it.
+static void loadTasks (TF2* file, std::exception_ptr* error)
+{
+  try
+  {
+    file->get_tasks ();
+  }
+
+  catch (...)
+  {
+    *error = std::current_exception ();
+  }
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Reverts an expired waiting task to pending.
+static bool wake (Task& task, const Date& now)
+{
+  Date wait (task.get_date ("wait"));
+  if (wait < now)
+  {
+    task.set ("status", "pending");
+    task.remove ("wait");
+    return true;
+  }
+
+  return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Scans the pending tasks for any that are completed or deleted, and if so,
 // moves them to the completed.data file.  Returns a count of tasks moved.
@@ -1198,120 +2769,141 @@ int TDB2::gc ()
   // Allowed as an override, but not recommended.
   if (context.config.getBoolean ("gc"))
   {
-    std::vector <Task> pending_tasks = pending.get_tasks ();
-
-    // TODO Thread.
-    std::vector <Task> completed_tasks = completed.get_tasks ();
-
-    // TODO Assume pending < completed, therefore there is room here to process
-    //      data before joining with the completed.data thread.
+    pending.get_tasks ();
+
+    // The completed.data index shows which of its tasks may need to be
+    // relocated to pending, and only those are parsed.  Without a current
+    // index, the whole file is scanned.
+    std::vector <Task> candidates;
+    bool scan_completed = true;
+    if (! completed._loaded_tasks &&
+        completed.load_index ())
+    {
+      std::vector <unsigned int> records;
+      const std::vector <Task>& index = completed.get_index ();
+      for (unsigned int r = 0; r < index.size (); ++r)
+      {
+        Task::status status = index[r].getStatus ();
+        if (status != Task::completed &&
+            status != Task::deleted)
+          records.push_back (r);
+      }
 
-    bool pending_changes = false;
-    bool completed_changes = false;
-    std::vector <Task> pending_tasks_after;
-    std::vector <Task> completed_tasks_after;
+      scan_completed = records.size () &&
+                       ! completed.get_records (records, candidates);
+    }
 
-    // Reduce unnecessary allocation/copies.
-    pending_tasks_after.reserve (pending_tasks.size ());
+    // completed.data is loaded in a separate thread, while pending tasks are
+    // scanned.  Nothing else touches completed until the thread is joined.
+#ifdef HAVE_LIBPTHREAD
+    std::exception_ptr error;
+    std::thread loader;
+    if (scan_completed)
+      loader = std::thread (loadTasks, &completed, &error);
+#endif
 
     // Scan all pending tasks, looking for any that need to be relocated to
-    // completed, or need to be 'woken'.
+    // completed, or need to be 'woken'.  The remaining tasks are compacted in
+    // place, so that only the relocated tasks are copied.  In journal mode,
+    // the changes are also queued to be appended to pending.data.
     Date now;
+    bool journal = context.config.getBoolean ("data.journal");
+    bool pending_changes = false;
+    std::vector <Task> leaving;
+    std::vector <Task>& tasks = pending._tasks;
     std::string status;
-    std::vector <Task>::iterator task;
-    for (task = pending_tasks.begin ();
-         task != pending_tasks.end ();
-         ++task)
+    unsigned int kept = 0;
+    for (unsigned int t = 0; t < tasks.size (); ++t)
     {
-      status = task->get ("status");
-      if (status == "pending" ||
-          status == "recurring")
-      {
-        pending_tasks_after.push_back (*task);
-      }
-      else if (status == "waiting")
+      status = tasks[t].get ("status");
+      if (status == "waiting")
       {
-        Date wait (task->get_date ("wait"));
-        if (wait < now)
+        if (wake (tasks[t], now))
         {
-          task->set ("status", "pending");
-          task->remove ("wait");
+          if (journal)
+            pending._replaced_tasks.push_back (tasks[t]);
+
           pending_changes = true;
         }
-
-        pending_tasks_after.push_back (*task);
       }
-      else
+      else if (status != "pending" &&
+               status != "recurring")
       {
-        completed_tasks_after.push_back (*task);
+        if (journal)
+          pending._removed_uuids.push_back (tasks[t].get ("uuid"));
+
+        leaving.push_back (tasks[t]);
         pending_changes = true;
-        completed_changes = true;
+        continue;
       }
+
+      if (kept != t)
+        tasks[kept] = tasks[t];
+
+      ++kept;
     }
 
-    // TODO Join completed.data thread.
+    tasks.resize (kept);
+
+    // Join the completed.data thread.
+#ifdef HAVE_LIBPTHREAD
+    if (loader.joinable ())
+      loader.join ();
 
-    // Reduce unnecessary allocation/copies.
-    completed_tasks_after.reserve (completed_tasks.size ());
+    if (error)
+      std::rethrow_exception (error);
+#endif
+
+    if (scan_completed)
+    {
+      const std::vector <Task>& all = completed.get_tasks ();
+      std::vector <Task>::const_iterator i;
+      for (i = all.begin (); i != all.end (); ++i)
+        if (i->getStatus () != Task::completed &&
+            i->getStatus () != Task::deleted)
+          candidates.push_back (*i);
+    }
 
-    // Scan all completed tasks, looking for any that need to be relocated to
-    // pending.
-    for (task = completed_tasks.begin ();
-         task != completed_tasks.end ();
-         ++task)
+    // Completed tasks that need to be relocated to pending are removed from
+    // completed.data all at once.
+    std::vector <std::string> returning;
+    std::vector <Task>::iterator task;
+    for (task = candidates.begin (); task != candidates.end (); ++task)
     {
       status = task->get ("status");
-      if (status == "pending" ||
-          status == "recurring")
+      if (status == "pending"   ||
+          status == "recurring" ||
+          status == "waiting")
       {
-        pending_tasks_after.push_back (*task);
-        pending_changes = true;
-        completed_changes = true;
-      }
-      else if (status == "waiting")
-      {
-        Date wait (task->get_date ("wait"));
-        if (wait < now)
-        {
-          task->set ("status", "pending");
-          task->remove ("wait");
-          pending_tasks_after.push_back (*task);
-          pending_changes = true;
-          completed_changes = true;
-        }
+        returning.push_back (task->get ("uuid"));
+        if (status == "waiting")
+          wake (*task, now);
 
-        pending_tasks_after.push_back (*task);
-      }
-      else
-      {
-        completed_tasks_after.push_back (*task);
+        if (journal)
+          pending._relocated_tasks.push_back (*task);
+
+        tasks.push_back (*task);
+        pending_changes = true;
       }
     }
 
-    // Only recreate the pending.data file if necessary.
+    if (returning.size ())
+      completed.remove_tasks (returning);
+
+    // Tasks relocated to completed are appended to completed.data.
+    for (task = leaving.begin (); task != leaving.end (); ++task)
+      completed.relocate_task (*task);
+
+    // Only recreate or append to the pending.data file if necessary.
     if (pending_changes)
     {
-      pending._tasks = pending_tasks_after;
       pending._dirty = true;
-      pending._loaded_tasks = true;
       _id = 1;
 
-      for (task = pending._tasks.begin ();
-           task != pending._tasks.end ();
-           ++task)
-      {
+      for (task = tasks.begin (); task != tasks.end (); ++task)
         task->id = _id++;
-      }
-
-      // Note: deliberately no commit.
-    }
 
-    // Only recreate the completed.data file if necessary.
-    if (completed_changes)
-    {
-      completed._tasks = completed_tasks_after;
-      completed._dirty = true;
-      completed._loaded_tasks = true;
+      pending.reindex ();
 
       // Note: deliberately no commit.
     }
@@ -1327,6 +2919,14 @@ int TDB2::gc ()
   return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Compacts pending.data and completed.data on commit, and returns the number of
+// obsolete records dropped.
+int TDB2::compact ()
+{
+  return pending.compact () + completed.compact ();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Next ID is that of the last pending task plus one.
 int TDB2::next_id ()
@@ -1472,6 +3072,47 @@ bool TDB2::verifyUniqueUUID (const std::string& uuid)
   return pending.id (uuid) != 0 ? false : true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// A delta undo record holds the new values of the added and changed
+// attributes, then the old values of the changed and removed attributes, both
+// as FF4 records keyed by the UUID.  As FF4 escapes brackets in values, the
+// two records are separated by the first "] [".
+std::string TDB2::composeDelta (const Task& before, const Task& after)
+{
+  std::string uuid = after.get ("uuid");
+
+  Task added;
+  Task removed;
+  Task::const_iterator att;
+  for (att = after.begin (); att != after.end (); ++att)
+    if (att->second != before.get (att->first))
+      added[att->first] = att->second;
+
+  for (att = before.begin (); att != before.end (); ++att)
+    if (att->second != after.get (att->first))
+      removed[att->first] = att->second;
+
+  added["uuid"] = uuid;
+  removed["uuid"] = uuid;
+
+  std::string delta;
+  added.composeF4 (delta);
+  delta += ' ';
+  removed.composeF4 (delta);
+  return delta;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TDB2::parseDelta (const std::string& delta, Task& before, Task& after)
+{
+  std::string::size_type split = delta.find ("] [");
+  if (split == std::string::npos)
+    throw std::string (STRING_RECORD_NOT_FF4);
+
+  after.parse (delta.substr (0, split + 1));
+  before.parse (delta.substr (split + 2));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool TDB2::read_only ()
 {
@@ -1492,6 +3133,8 @@ void TDB2::clear ()
 
   _location = "";
   _id = 1;
+  _modifications.clear ();
+  _modification_slots.clear ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
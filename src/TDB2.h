@@ -28,11 +28,14 @@
 #define INCLUDED_TDB2
 
 #include <map>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <stdio.h>
 #include <ViewText.h>
 #include <File.h>
+#include <Snapshot.h>
 #include <Task.h>
 
 // TF2 Class represents a single file in the task database.
@@ -52,8 +55,14 @@ public:
   bool has (const std::string&);
 
   void add_task (Task&);
+  void relocate_task (const Task&);
+  void remove_task (const Task&);
+  void remove_tasks (const std::vector <std::string>&);
   bool modify_task (const Task&);
+  bool replace_task (const Task&);
+  bool replace_modified (unsigned int, const Task&);
   void add_line (const std::string&);
+  void replace_line (unsigned int, const std::string&);
   void clear_tasks ();
   void clear_lines ();
   void commit ();
@@ -61,16 +70,48 @@ public:
   void load_tasks ();
   void load_lines ();
 
+  // Index of the records in the file, holding only indexed attributes.
+  bool load_index ();
+  const std::vector <Task>& get_index ();
+  bool get_records (const std::vector <unsigned int>&, std::vector <Task>&);
+  static bool indexed_attribute (const std::string&);
+
+  // Index of the transactions in an undo file, by UUID and line offset.
+  bool get_transactions (const std::string&, std::vector <std::string>&);
+  bool last_transaction (std::vector <std::string>&);
+  bool remove_transaction ();
+
   // ID <--> UUID mapping.
   std::string uuid (int);
   int id (const std::string&);
 
+  // Dependency graph of the loaded tasks.
+  void get_blocked (const std::string&, std::vector <Task>&);
+  void get_blocking (const Task&, std::vector <Task>&);
+  const std::vector <unsigned int>& dependency_order ();
+  float inherited_urgency (const std::string&);
+
   void has_ids ();
   void auto_dep_scan ();
+  void indexed ();
+  void transactional ();
   void clear ();
+  int  compact ();
+  void remove_snapshots ();
+  void reindex ();
   const std::string dump ();
 
 private:
+  bool store_task (const Task&);
+  void load_task (Task&);
+  void build_index (unsigned int, const std::vector <unsigned long long>&);
+  void index_task (unsigned int);
+  void load_transactions ();
+  void index_transaction (const std::string&, unsigned long long);
+  void drop (const std::vector <std::string>&);
+  void build_graph ();
+  void build_inheritance ();
+  float inherit_from (const std::string&) const;
   void dependency_scan ();
 
 public:
@@ -80,16 +121,35 @@ public:
   bool _loaded_lines;
   bool _has_ids;
   bool _auto_dep_scan;
+  bool _indexed;
+  bool _transactional;
+  bool _loaded_index;
+  bool _compact;
   std::vector <Task> _tasks;
   std::vector <Task> _added_tasks;
+  std::vector <Task> _relocated_tasks;
+  std::vector <Task> _replaced_tasks;          // Changed by gc, not reported
+  std::vector <std::string> _removed_uuids;
   std::vector <Task> _modified_tasks;
   std::vector <std::string> _lines;
   std::vector <std::string> _added_lines;
   File _file;
 
 private:
-  std::map <int, std::string> _I2U; // ID -> UUID map
-  std::map <std::string, int> _U2I; // UUID -> ID map
+  Snapshot _snapshot;
+  Snapshot _index;
+  std::vector <Task> _index_tasks;
+  std::vector <unsigned long long> _index_lines;
+  unsigned long long _indexed_size;                            // Transactions indexed up to
+  std::unordered_map <std::string, unsigned int> _uuid_slots; // UUID -> _tasks index
+  std::vector <int> _id_slots;                                 // ID -> _tasks index, or -1
+  bool _graph_current;
+  std::vector <std::vector <unsigned int>> _blocking_slots;   // Slot -> slots it depends on
+  std::unordered_map <std::string, std::vector <unsigned int>> _blocked_slots; // UUID -> slots depending on it
+  std::vector <unsigned int> _dependency_order;               // Slots, each after its dependencies
+  bool _inheritance_current;
+  std::vector <float> _inherited;                             // Slot -> urgency inherited
+  std::mutex _graph_mutex;                                    // Filters query from several threads
 };
 
 // TDB2 Class represents all the files in the task database.
@@ -101,11 +161,13 @@ public:
 
   void set_location (const std::string&);
   void add (Task&, bool add_to_backlog = true);
+  void add (std::vector <Task>&);
   void modify (Task&, bool add_to_backlog = true);
   void commit ();
   void get_changes (std::vector <Task>&);
   void revert ();
   int  gc ();
+  int  compact ();
   int  next_id ();
 
   // Generalized task accessors.
@@ -123,18 +185,29 @@ public:
   // Read-only mode.
   bool read_only ();
 
+  // Undo transactions and bytes, across undo.data and its segments.
+  void undo_statistics (int&, size_t&);
+
+  // Delta undo records.
+  static std::string composeDelta (const Task&, const Task&);
+  static void parseDelta (const std::string&, Task&, Task&);
+
   void clear ();
   void dump ();
 
 private:
   void gather_changes ();
+  void batch_modifications ();
   void update (const std::string&, Task&, const bool, const bool addition = false);
   bool verifyUniqueUUID (const std::string&);
   void show_diff (const std::string&, const std::string&, const std::string&);
+  void rotate_undo ();
+  bool restore_undo ();
   void revert_undo (std::vector <std::string>&, std::string&, std::string&, std::string&, std::string&);
-  void revert_pending (std::vector <std::string>&, const std::string&, const std::string&, const std::string&);
-  void revert_completed (std::vector <std::string>&, std::vector <std::string>&, const std::string&, const std::string&, const std::string&);
-  void revert_backlog (std::vector <std::string>&, const std::string&, const std::string&, const std::string&);
+  bool revert_current (const std::string&, Task&);
+  void revert_pending (const std::string&, const std::string&, const std::string&);
+  bool revert_completed (const std::string&, const std::string&, const std::string&);
+  bool revert_backlog (std::vector <std::string>&, const std::string&, const std::string&, const std::string&);
 
 public:
   TF2 pending;
@@ -143,9 +216,22 @@ public:
   TF2 backlog;
 
 private:
+  // A task modified by the command, for the on-modify-batch hooks.
+  struct Modification
+  {
+    Task         original;      // Before the command
+    Task         previous;      // Before the last modification
+    TF2*         file;          // Holding the task
+    unsigned int modified;      // Position among the file's modified tasks
+    unsigned int undo_line;     // Delta of the last modification
+    unsigned int backlog_line;
+  };
+
   std::string        _location;
   int                _id;
   std::vector <Task> _changes;
+  std::vector <Modification> _modifications;
+  std::unordered_map <std::string, unsigned int> _modification_slots; // UUID -> _modifications index
 };
 
 #endif
@@ -32,6 +32,9 @@
 #include <math.h>
 #endif
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #ifdef PRODUCT_TASKWARRIOR
 #include <Context.h>
 #include <Nibbler.h>
@@ -59,9 +62,19 @@
 #define APPROACHING_INFINITY 1000   // Close enough.  This isn't rocket surgery.
 
 extern Context context;
-extern Task& contextTask;
+extern thread_local const Task* contextTask;
 
 static const float epsilon = 0.000001;
+
+////////////////////////////////////////////////////////////////////////////////
+// DOM references in modifications refer to a copy of the task being modified,
+// which outlives the modification.
+static void setContextTask (const Task& task)
+{
+  static Task copy;
+  copy = task;
+  contextTask = &copy;
+}
 #endif
 
 std::string Task::defaultProject  = "";
@@ -89,6 +102,215 @@ float Task::urgencyAgeMax                 = 0.0;
 
 static const std::string dummy ("");
 
+////////////////////////////////////////////////////////////////////////////////
+// The moments against which date attributes are classified.  A command takes
+// them all from a single "now", computed on first use, instead of building the
+// same named dates again for every task it looks at.
+struct Moments
+{
+  Moments ();
+
+  time_t now;
+  time_t yesterday;
+  time_t today;
+  time_t tomorrow;
+  time_t overmorrow;
+  time_t imminent;
+  time_t socw;
+  time_t eocw;
+  time_t socm;
+  time_t eocm;
+  time_t soy;
+  time_t eoy;
+};
+
+Moments::Moments ()
+{
+  now        = Date ().toEpoch ();
+  yesterday  = Date ("yesterday").toEpoch ();
+  today      = Date ("today").toEpoch ();
+  tomorrow   = Date ("tomorrow").toEpoch ();
+  overmorrow = (Date (tomorrow) + 90001).startOfDay ().toEpoch ();
+  socw       = Date ("socw").toEpoch ();
+  eocw       = Date ("eocw").toEpoch ();
+  socm       = Date ("socm").toEpoch ();
+  eocm       = Date ("eocm").toEpoch ();
+  soy        = Date (1, 1, Date (now).year ()).toEpoch ();
+  eoy        = Date ("eoy").toEpoch ();
+
+  int imminentperiod = context.config.getInteger ("due");
+  imminent = imminentperiod ? (Date (today) + imminentperiod * 86400).toEpoch () : 0;
+}
+
+static const Moments& moments ()
+{
+  static const Moments instance;
+  return instance;
+}
+
+#ifdef PRODUCT_TASKWARRIOR
+////////////////////////////////////////////////////////////////////////////////
+// The due and age urgency terms, shared by urgency_due, urgency_age and
+// urgency_batch.
+static inline float dueTerm (time_t due)
+{
+  // Map a range of 21 days to the value 0.2 - 1.0
+  float days_overdue = (moments ().now - due) / 86400.0;
+       if (days_overdue >= 7.0)   return 1.0;   // < 1 wk ago
+  else if (days_overdue >= -14.0) return ((days_overdue + 14.0) * 0.8 / 21.0) + 0.2;
+  else                            return 0.2;   // > 2 wks
+}
+
+static inline float ageTerm (time_t entry)
+{
+  int age = (moments ().now - entry) / 86400;  // in days
+
+  if (Task::urgencyAgeMax == 0 || age > Task::urgencyAgeMax)
+    return 1.0;
+
+  return (1.0 * age / Task::urgencyAgeMax);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Names are interned in a set whose elements never move, so the address of the
+// stored name serves as its identity.  Tasks are parsed on several threads, so
+// the set is guarded, and each thread remembers the names it has seen.
+const std::string* Attributes::intern (const std::string& name)
+{
+  static thread_local std::unordered_map <std::string, const std::string*> seen;
+  auto known = seen.find (name);
+  if (known != seen.end ())
+    return known->second;
+
+  static std::mutex guard;
+  static std::unordered_set <std::string> names;
+
+  const std::string* interned;
+  {
+    std::lock_guard <std::mutex> lock (guard);
+    interned = &*names.insert (name).first;
+  }
+
+  seen[name] = interned;
+  return interned;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long Attributes::const_iterator::number () const
+{
+  if (! _i->parsed)
+  {
+    _i->number = strtoll (_i->value.c_str (), NULL, 10);
+    _i->parsed = true;
+  }
+
+  return _i->number;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The first slot whose name is not less than the given name.
+std::vector <Attributes::Slot>::iterator Attributes::lookup (const std::string& name)
+{
+  std::vector <Slot>::iterator first = _slots.begin ();
+  size_t count = _slots.size ();
+  while (count > 0)
+  {
+    size_t half = count / 2;
+    if (*first[half].name < name)
+    {
+      first += half + 1;
+      count -= half + 1;
+    }
+    else
+      count = half;
+  }
+
+  return first;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Attributes::iterator Attributes::find (const std::string& name)
+{
+  std::vector <Slot>::iterator i = lookup (name);
+  if (i != _slots.end () && *i->name == name)
+    return i;
+
+  return _slots.end ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Attributes::const_iterator Attributes::find (const std::string& name) const
+{
+  return const_cast <Attributes*> (this)->find (name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t Attributes::count (const std::string& name) const
+{
+  return find (name) != end () ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string& Attributes::operator[] (const std::string& name)
+{
+  std::vector <Slot>::iterator i = lookup (name);
+  if (i == _slots.end () || *i->name != name)
+  {
+    Slot slot = {intern (name), "", 0, false};
+    i = _slots.insert (i, slot);
+  }
+
+  i->parsed = false;
+  return i->value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// As with std::map, an existing attribute is left alone.
+void Attributes::insert (const std::pair <const std::string, std::string>& attribute)
+{
+  std::vector <Slot>::iterator i = lookup (attribute.first);
+  if (i == _slots.end () || *i->name != attribute.first)
+  {
+    Slot slot = {intern (attribute.first), attribute.second, 0, false};
+    _slots.insert (i, slot);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Attributes::iterator Attributes::erase (iterator i)
+{
+  return _slots.erase (i._i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t Attributes::erase (const std::string& name)
+{
+  iterator i = find (name);
+  if (i == end ())
+    return 0;
+
+  _slots.erase (i._i);
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Attributes::append (const std::string* name, const std::string& value)
+{
+  Slot slot = {name, value, 0, false};
+  _slots.push_back (slot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Attributes::append (
+  const std::string* name,
+  const std::string& value,
+  long long number)
+{
+  Slot slot = {name, value, number, true};
+  _slots.push_back (slot);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 Task::Task ()
 : id (0)
@@ -111,7 +333,7 @@ Task& Task::operator= (const Task& other)
 {
   if (this != &other)
   {
-    std::map <std::string, std::string>::operator= (other);
+    Attributes::operator= (other);
     id               = other.id;
     urgency_value    = other.urgency_value;
     recalc_urgency   = other.recalc_urgency;
@@ -130,7 +352,7 @@ bool Task::operator== (const Task& other)
   if (size () != other.size ())
     return false;
 
-  Task::iterator i;
+  Task::const_iterator i;
   for (i = this->begin (); i != this->end (); ++i)
     if (i->first != "uuid" &&
         i->second != other.get (i->first))
@@ -237,7 +459,7 @@ int Task::get_int (const std::string& name) const
 {
   Task::const_iterator i = this->find (name);
   if (i != this->end ())
-    return strtol (i->second.c_str (), NULL, 10);
+    return (int) i.number ();
 
   return 0;
 }
@@ -247,7 +469,7 @@ unsigned long Task::get_ulong (const std::string& name) const
 {
   Task::const_iterator i = this->find (name);
   if (i != this->end ())
-    return strtoul (i->second.c_str (), NULL, 10);
+    return (unsigned long) i.number ();
 
   return 0;
 }
@@ -267,7 +489,7 @@ time_t Task::get_date (const std::string& name) const
 {
   Task::const_iterator i = this->find (name);
   if (i != this->end ())
-    return (time_t) strtoul (i->second.c_str (), NULL, 10);
+    return (time_t) i.number ();
 
   return 0;
 }
@@ -317,30 +539,27 @@ void Task::setStatus (Task::status status)
 // Determines status of a date attribute.
 Task::dateState Task::getDateState (const std::string& name) const
 {
-  std::string value = get (name);
-  if (value.length ())
+  Task::const_iterator i = this->find (name);
+  if (i != this->end () && i->second.length ())
   {
-    Date reference (value);
-    Date now;
-    Date today ("today");
+    time_t reference = (time_t) i.number ();
+    const Moments& m = moments ();
 
-    if (reference < today)
+    if (reference < m.today)
       return dateBeforeToday;
 
-    if (reference.sameDay (now))
+    if (reference < m.tomorrow)
     {
-      if (reference < now)
+      if (reference < m.now)
         return dateEarlierToday;
       else
         return dateLaterToday;
     }
 
-    int imminentperiod = context.config.getInteger ("due");
-    if (imminentperiod == 0)
+    if (m.imminent == 0)
       return dateAfterToday;
 
-    Date imminentDay = today + imminentperiod * 86400;
-    if (reference < imminentDay)
+    if (reference < m.imminent)
       return dateAfterToday;
   }
 
@@ -356,7 +575,7 @@ bool Task::is_ready () const
   return getStatus () == Task::pending &&
          !is_blocked                   &&
          (! has ("scheduled")          ||
-          Date ("now").operator> (get_date ("scheduled")));
+          moments ().now > get_date ("scheduled"));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -390,7 +609,9 @@ bool Task::is_dueyesterday () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      if (Date ("yesterday").sameDay (get_date ("due")))
+      time_t due = get_date ("due");
+      if (due >= moments ().yesterday &&
+          due <  moments ().today)
         return true;
     }
   }
@@ -428,7 +649,9 @@ bool Task::is_duetomorrow () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      if (Date ("tomorrow").sameDay (get_date ("due")))
+      time_t due = get_date ("due");
+      if (due >= moments ().tomorrow &&
+          due <  moments ().overmorrow)
         return true;
     }
   }
@@ -446,9 +669,9 @@ bool Task::is_dueweek () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      Date due (get_date ("due"));
-      if (due >= Date ("socw") &&
-          due <= Date ("eocw"))
+      time_t due = get_date ("due");
+      if (due >= moments ().socw &&
+          due <= moments ().eocw)
         return true;
     }
   }
@@ -466,9 +689,9 @@ bool Task::is_duemonth () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      Date due (get_date ("due"));
-      if (due >= Date ("socm") &&
-          due <= Date ("eocm"))
+      time_t due = get_date ("due");
+      if (due >= moments ().socm &&
+          due <= moments ().eocm)
         return true;
     }
   }
@@ -486,9 +709,9 @@ bool Task::is_dueyear () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      Date now;
-      Date due (get_date ("due"));
-      if (now.year () == due.year ())
+      time_t due = get_date ("due");
+      if (due >= moments ().soy &&
+          due <= moments ().eoy)
         return true;
     }
   }
@@ -630,12 +853,20 @@ void Task::parseJSON (const std::string& line)
           set ("modified", d.toEpochString ());
         }
 
-        // Dates are converted from ISO to epoch.
+        // Dates are converted from ISO to epoch.  The ISO format of export is
+        // tried first, as it is the most likely.
         else if (type == "date")
         {
           std::string text = unquoteText (i->second->dump ());
-          Date d (text);
-          set (i->first, text == "" ? "" : d.toEpochString ());
+          Nibbler n (text);
+          time_t t;
+          if (n.getDateISO (t) && n.depleted ())
+            set (i->first, Date (t).toEpochString ());
+          else
+          {
+            Date d (text);
+            set (i->first, text == "" ? "" : d.toEpochString ());
+          }
         }
 
         // Tags are an array of JSON strings.
@@ -758,7 +989,17 @@ void Task::parseLegacy (const std::string& line)
 //
 std::string Task::composeF4 () const
 {
-  std::string ff4 = "[";
+  std::string ff4;
+  composeF4 (ff4);
+  return ff4;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Appends the FF4 record to the buffer, without intermediate strings.  Values
+// are JSON-escaped, and brackets are encoded as &open; and &close;.
+void Task::composeF4 (std::string& ff4) const
+{
+  ff4 += '[';
 
   bool first = true;
   Task::const_iterator it;
@@ -766,18 +1007,42 @@ std::string Task::composeF4 () const
   {
     if (it->second != "")
     {
-      ff4 += (first ? "" : " ")
-           + it->first
-           + ":\""
-           + encode (json::encode (it->second))
-           + "\"";
+      if (! first)
+        ff4 += ' ';
+
+      ff4 += it->first;
+      ff4 += ":\"";
 
+      const std::string& value = it->second;
+      std::string::size_type start = 0;
+      std::string::size_type special;
+      while ((special = value.find_first_of ("\"\\/\b\f\n\r\t[]", start)) != std::string::npos)
+      {
+        ff4.append (value, start, special - start);
+        switch (value[special])
+        {
+        case '"':  ff4 += "\\\"";   break;
+        case '\\': ff4 += "\\\\";   break;
+        case '/':  ff4 += "\\/";    break;
+        case '\b': ff4 += "\\b";    break;
+        case '\f': ff4 += "\\f";    break;
+        case '\n': ff4 += "\\n";    break;
+        case '\r': ff4 += "\\r";    break;
+        case '\t': ff4 += "\\t";    break;
+        case '[':  ff4 += "&open;";  break;
+        case ']':  ff4 += "&close;"; break;
+        }
+
+        start = special + 1;
+      }
+
+      ff4.append (value, start, std::string::npos);
+      ff4 += '"';
       first = false;
     }
   }
 
-  ff4 += "]";
-  return ff4;
+  ff4 += ']';
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -949,7 +1214,7 @@ void Task::removeAnnotations ()
     if (i->first.substr (0, 11) == "annotation_")
     {
       --annotation_count;
-      this->erase (i++);
+      i = this->erase (i);
     }
     else
       i++;
@@ -966,7 +1231,7 @@ void Task::getAnnotations (std::map <std::string, std::string>& annotations) con
   Task::const_iterator ci;
   for (ci = this->begin (); ci != this->end (); ++ci)
     if (ci->first.substr (0, 11) == "annotation_")
-      annotations.insert (*ci);
+      annotations.insert (std::make_pair (ci->first, ci->second));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1077,6 +1342,103 @@ void Task::getDependencies (std::vector <std::string>& all) const
 }
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+// Synthetic tags - dynamically generated, but do not occupy storage space.
+static bool isActive    (const Task& task) { return task.has ("start");                   }
+static bool isAnnotated (const Task& task) { return task.hasAnnotations ();               }
+static bool isBlocked   (const Task& task) { return task.is_blocked;                      }
+static bool isBlocking  (const Task& task) { return task.is_blocking;                     }
+static bool isChild     (const Task& task) { return task.has ("parent");                  }
+static bool isCompleted (const Task& task) { return task.get ("status") == "completed";   }
+static bool isDeleted   (const Task& task) { return task.get ("status") == "deleted";     }
+static bool isParent    (const Task& task) { return task.has ("mask");                    }
+static bool isPending   (const Task& task) { return task.get ("status") == "pending";     }
+static bool isScheduled (const Task& task) { return task.has ("scheduled");               }
+static bool isTagged    (const Task& task) { return task.has ("tags");                    }
+static bool isUnblocked (const Task& task) { return ! task.is_blocked;                    }
+static bool isUntil     (const Task& task) { return task.has ("until");                   }
+static bool isWaiting   (const Task& task) { return task.get ("status") == "waiting";     }
+#ifdef PRODUCT_TASKWARRIOR
+static bool isDue       (const Task& task) { return task.is_due ();                       }
+static bool isDueToday  (const Task& task) { return task.is_duetoday ();                  }
+static bool isMonth     (const Task& task) { return task.is_duemonth ();                  }
+static bool isOverdue   (const Task& task) { return task.is_overdue ();                   }
+static bool isReady     (const Task& task) { return task.is_ready ();                     }
+static bool isTomorrow  (const Task& task) { return task.is_duetomorrow ();               }
+static bool isWeek      (const Task& task) { return task.is_dueweek ();                   }
+static bool isYear      (const Task& task) { return task.is_dueyear ();                   }
+static bool isYesterday (const Task& task) { return task.is_dueyesterday ();              }
+#endif
+
+// The one list of virtual tags, in alphabetical order.  Indexed tags depend
+// only on attributes that a completed.data index keeps.
+struct VirtualTag
+{
+  const char* name;
+  bool (*test) (const Task&);
+  bool indexed;
+};
+
+static const VirtualTag virtualTags[] =
+{
+  {"ACTIVE",    isActive,    false},
+  {"ANNOTATED", isAnnotated, false},
+  {"BLOCKED",   isBlocked,   true},
+  {"BLOCKING",  isBlocking,  true},
+  {"CHILD",     isChild,     false},
+  {"COMPLETED", isCompleted, true},
+  {"DELETED",   isDeleted,   true},
+#ifdef PRODUCT_TASKWARRIOR
+  {"DUE",       isDue,       false},
+  {"DUETODAY",  isDueToday,  false},
+  {"MONTH",     isMonth,     false},
+  {"OVERDUE",   isOverdue,   false},
+#endif
+  {"PARENT",    isParent,    false},
+  {"PENDING",   isPending,   true},
+#ifdef PRODUCT_TASKWARRIOR
+  {"READY",     isReady,     false},
+#endif
+  {"SCHEDULED", isScheduled, false},
+  {"TAGGED",    isTagged,    true},
+#ifdef PRODUCT_TASKWARRIOR
+  {"TODAY",     isDueToday,  false},
+  {"TOMORROW",  isTomorrow,  false},
+#endif
+  {"UNBLOCKED", isUnblocked, true},
+  {"UNTIL",     isUntil,     false},
+  {"WAITING",   isWaiting,   true},
+#ifdef PRODUCT_TASKWARRIOR
+  {"WEEK",      isWeek,      false},
+  {"YEAR",      isYear,      false},
+  {"YESTERDAY", isYesterday, false},
+#endif
+};
+
+static const VirtualTag* findVirtualTag (const std::string& tag)
+{
+  for (unsigned int i = 0; i < sizeof (virtualTags) / sizeof (virtualTags[0]); ++i)
+    if (tag == virtualTags[i].name)
+      return &virtualTags[i];
+
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Task::isVirtualTag (const std::string& tag)
+{
+  return findVirtualTag (tag) != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Whether the tag can be tested on a task loaded from a completed.data index,
+// which keeps the tags, but not all the attributes virtual tags depend on.
+bool Task::isIndexedTag (const std::string& tag)
+{
+  const VirtualTag* virtualTag = findVirtualTag (tag);
+  return ! virtualTag || virtualTag->indexed;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 int Task::getTagCount () const
 {
@@ -1099,34 +1461,10 @@ int Task::getTagCount () const
 //
 bool Task::hasTag (const std::string& tag) const
 {
-  // Synthetic tags - dynamically generated, but do not occupy storage space.
-  // Note: This list must match that in CmdInfo::execute.
-  if (tag == "BLOCKED")   return is_blocked;
-  if (tag == "UNBLOCKED") return !is_blocked;
-  if (tag == "BLOCKING")  return is_blocking;
-#ifdef PRODUCT_TASKWARRIOR
-  if (tag == "READY")     return is_ready ();
-  if (tag == "DUE")       return is_due ();
-  if (tag == "DUETODAY")  return is_duetoday ();
-  if (tag == "TODAY")     return is_duetoday ();
-  if (tag == "YESTERDAY") return is_dueyesterday ();
-  if (tag == "TOMORROW")  return is_duetomorrow ();
-  if (tag == "OVERDUE")   return is_overdue ();
-  if (tag == "WEEK")      return is_dueweek ();
-  if (tag == "MONTH")     return is_duemonth ();
-  if (tag == "YEAR")      return is_dueyear ();
-#endif
-  if (tag == "ACTIVE")    return has ("start");
-  if (tag == "SCHEDULED") return has ("scheduled");
-  if (tag == "CHILD")     return has ("parent");
-  if (tag == "UNTIL")     return has ("until");
-  if (tag == "ANNOTATED") return hasAnnotations ();
-  if (tag == "TAGGED")    return has ("tags");
-  if (tag == "PARENT")    return has ("mask");
-  if (tag == "WAITING")   return get ("status") == "waiting";
-  if (tag == "PENDING")   return get ("status") == "pending";
-  if (tag == "COMPLETED") return get ("status") == "completed";
-  if (tag == "DELETED")   return get ("status") == "deleted";
+  // Synthetic tags.
+  const VirtualTag* virtualTag = findVirtualTag (tag);
+  if (virtualTag)
+    return virtualTag->test (*this);
 
   // Concrete tags.
   std::vector <std::string> tags;
@@ -1173,6 +1511,16 @@ void Task::getTags (std::vector<std::string>& tags) const
   split (tags, get ("tags"), ',');
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The virtual tags that apply to the task, in alphabetical order.
+void Task::getVirtualTags (std::vector<std::string>& tags) const
+{
+  tags.clear ();
+  for (unsigned int i = 0; i < sizeof (virtualTags) / sizeof (virtualTags[0]); ++i)
+    if (virtualTags[i].test (*this))
+      tags.push_back (virtualTags[i].name);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void Task::removeTag (const std::string& tag)
 {
@@ -1423,7 +1771,7 @@ void Task::validate (bool applyDefault /* = true */)
     Config::const_iterator var;
     for (var = context.config.begin (); var != context.config.end (); ++var)
     {
-      if (var->first.substr (0, 4) == "uda." &&
+      if (var->first.compare (0, 4, "uda.") == 0 &&
           var->first.find (".default") != std::string::npos)
       {
         std::string::size_type period = var->first.find ('.', 4);
@@ -1516,20 +1864,6 @@ void Task::validate_before (const std::string& left, const std::string& right)
 #endif
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// Encode values prior to serialization.
-//   [  -> &open;
-//   ]  -> &close;
-const std::string Task::encode (const std::string& value) const
-{
-  std::string modified = value;
-
-  str_replace (modified, "[",  "&open;");
-  str_replace (modified, "]",  "&close;");
-
-  return modified;
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 // Decode values after parse.
 //   "  <- &dquot;
@@ -1636,6 +1970,120 @@ int Task::determineVersion (const std::string& line)
   return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The tag-, project- and UDA-specific coefficients, compiled from
+// Task::coefficients once, so that urgency_c need not take apart every
+// coefficient name for every task.
+//
+// Project coefficients apply to any project beginning with the configured
+// text, so they are held in a trie, and a project collects the coefficients of
+// the nodes along its path.
+//
+// Each coefficient keeps its rank in Task::coefficients, and the matching ones
+// are summed in that order, which keeps the floating point result identical.
+typedef std::pair <unsigned int, float> Coefficient;   // rank, value
+
+struct ProjectNode
+{
+  std::map <char, unsigned int> next;
+  Coefficient coefficient;
+};
+
+struct UDACoefficients
+{
+  std::string name;
+  Coefficient present;                                     // urgency.uda.<name>
+  std::unordered_map <std::string, Coefficient> values;    // urgency.uda.<name>.<value>
+};
+
+static std::vector <ProjectNode> projectTrie;
+static std::unordered_map <std::string, Coefficient> tagCoefficients;
+static std::vector <std::pair <std::string, Coefficient>> virtualTagCoefficients;
+static std::vector <UDACoefficients> udaCoefficients;
+
+void Task::compileCoefficients ()
+{
+  projectTrie.clear ();
+  tagCoefficients.clear ();
+  virtualTagCoefficients.clear ();
+  udaCoefficients.clear ();
+
+  static const Coefficient none (0, 0.0);
+
+  unsigned int rank = 0;
+  std::map <std::string, float>::iterator var;
+  for (var = Task::coefficients.begin (); var != Task::coefficients.end (); ++var, ++rank)
+  {
+    std::string::size_type end = var->first.find (".coefficient");
+    if (fabs (var->second) <= epsilon ||
+        end == std::string::npos)
+      continue;
+
+    Coefficient coefficient (rank, var->second);
+
+    // urgency.user.project.<project>.coefficient
+    if (var->first.compare (0, 21, "urgency.user.project.") == 0 &&
+        end >= 21)
+    {
+      if (projectTrie.empty ())
+        projectTrie.push_back (ProjectNode {std::map <char, unsigned int> (), none});
+
+      unsigned int node = 0;
+      for (std::string::size_type c = 21; c < end; ++c)
+      {
+        std::map <char, unsigned int>::iterator next = projectTrie[node].next.find (var->first[c]);
+        if (next == projectTrie[node].next.end ())
+        {
+          projectTrie[node].next[var->first[c]] = projectTrie.size ();
+          node = projectTrie.size ();
+          projectTrie.push_back (ProjectNode {std::map <char, unsigned int> (), none});
+        }
+        else
+          node = next->second;
+      }
+
+      projectTrie[node].coefficient = coefficient;
+    }
+
+    // urgency.user.tag.<tag>.coefficient
+    else if (var->first.compare (0, 17, "urgency.user.tag.") == 0 &&
+             end >= 17)
+    {
+      std::string tag = var->first.substr (17, end - 17);
+      if (isVirtualTag (tag))
+        virtualTagCoefficients.push_back (std::pair <std::string, Coefficient> (tag, coefficient));
+      else
+        tagCoefficients[tag] = coefficient;
+    }
+
+    // urgency.uda.<name>.coefficient
+    // urgency.uda.<name>.<value>.coefficient
+    else if (var->first.compare (0, 12, "urgency.uda.") == 0 &&
+             end >= 12)
+    {
+      const std::string uda = var->first.substr (12, end - 12);
+      std::string::size_type dot = uda.find (".");
+      std::string name = uda.substr (0, dot);
+
+      std::vector <UDACoefficients>::iterator entry;
+      for (entry = udaCoefficients.begin (); entry != udaCoefficients.end (); ++entry)
+        if (entry->name == name)
+          break;
+
+      if (entry == udaCoefficients.end ())
+      {
+        udaCoefficients.push_back (UDACoefficients {name, none, std::unordered_map <std::string, Coefficient> ()});
+        entry = udaCoefficients.end () - 1;
+      }
+
+      if (dot == std::string::npos)
+        entry->present = coefficient;
+      else
+        entry->values[uda.substr (dot + 1)] = coefficient;
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Urgency is defined as a polynomial, the value of which is calculated in this
 // function, according to:
@@ -1669,60 +2117,7 @@ float Task::urgency_c () const
   value += fabsf (Task::urgencyAgeCoefficient)         > epsilon ? (urgency_age ()         * Task::urgencyAgeCoefficient)         : 0.0;
   value += fabsf (Task::urgencyInheritCoefficient)     > epsilon ? (urgency_inherit ()     * Task::urgencyInheritCoefficient)     : 0.0;
 
-  // Tag- and project-specific coefficients.
-  std::map <std::string, float>::iterator var;
-  for (var = Task::coefficients.begin (); var != Task::coefficients.end (); ++var)
-  {
-    if (fabs (var->second) > epsilon)
-    {
-      if (var->first.substr (0, 13) == "urgency.user.")
-      {
-        // urgency.user.project.<project>.coefficient
-        std::string::size_type end = std::string::npos;
-        if (var->first.substr (13, 8) == "project." &&
-            (end = var->first.find (".coefficient")) != std::string::npos)
-        {
-          std::string project = var->first.substr (21, end - 21);
-
-          if (get ("project").find (project) == 0)
-            value += var->second;
-        }
-
-        // urgency.user.tag.<tag>.coefficient
-        if (var->first.substr (13, 4) == "tag." &&
-            (end = var->first.find (".coefficient")) != std::string::npos)
-        {
-          std::string tag = var->first.substr (17, end - 17);
-
-          if (hasTag (tag))
-            value += var->second;
-        }
-      }
-      else if (var->first.substr (0, 12) == "urgency.uda.")
-      {
-        // urgency.uda.<name>.coefficient
-        // urgency.uda.<name>.<value>.coefficient
-        std::string::size_type end = var->first.find (".coefficient");
-        if (end != std::string::npos)
-        {
-          const std::string uda = var->first.substr (12, end - 12);
-          std::string::size_type dot = uda.find (".");
-          if (dot == std::string::npos)
-          {
-            // urgency.uda.<name>.coefficient
-            if (has (uda))
-              value += var->second;
-          }
-          else
-          {
-            // urgency.uda.<name>.<value>.coefficient
-            if (get (uda.substr(0, dot)) == uda.substr(dot+1))
-              value += var->second;
-          }
-        }
-      }
-    }
-  }
+  urgency_user (value);
 #endif
 
   return value;
@@ -1742,6 +2137,174 @@ float Task::urgency ()
   return urgency_value;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Adds the tag-, project- and UDA-specific coefficients that apply.
+void Task::urgency_user (float& value) const
+{
+#ifdef PRODUCT_TASKWARRIOR
+  static thread_local std::vector <Coefficient> matched;
+  matched.clear ();
+
+  std::vector <UDACoefficients>::const_iterator uda;
+  for (uda = udaCoefficients.begin (); uda != udaCoefficients.end (); ++uda)
+  {
+    Task::const_iterator att = this->find (uda->name);
+    if (att != this->end () && uda->present.second != 0.0)
+      matched.push_back (uda->present);
+
+    if (! uda->values.empty ())
+    {
+      std::unordered_map <std::string, Coefficient>::const_iterator v;
+      v = uda->values.find (att != this->end () ? att->second : "");
+      if (v != uda->values.end ())
+        matched.push_back (v->second);
+    }
+  }
+
+  // Project coefficients, along the path of the project in the trie.
+  if (! projectTrie.empty ())
+  {
+    if (projectTrie[0].coefficient.second != 0.0)
+      matched.push_back (projectTrie[0].coefficient);
+
+    const std::string& project = get_ref ("project");
+    unsigned int node = 0;
+    for (unsigned int c = 0; c < project.length (); ++c)
+    {
+      std::map <char, unsigned int>::const_iterator next;
+      if ((next = projectTrie[node].next.find (project[c])) == projectTrie[node].next.end ())
+        break;
+
+      node = next->second;
+      if (projectTrie[node].coefficient.second != 0.0)
+        matched.push_back (projectTrie[node].coefficient);
+    }
+  }
+
+  if (! tagCoefficients.empty () && has ("tags"))
+  {
+    std::vector <std::string> tags;
+    split (tags, get_ref ("tags"), ',');
+    std::sort (tags.begin (), tags.end ());
+    tags.erase (std::unique (tags.begin (), tags.end ()), tags.end ());
+
+    std::vector <std::string>::iterator tag;
+    for (tag = tags.begin (); tag != tags.end (); ++tag)
+    {
+      std::unordered_map <std::string, Coefficient>::const_iterator coefficient;
+      if ((coefficient = tagCoefficients.find (*tag)) != tagCoefficients.end ())
+        matched.push_back (coefficient->second);
+    }
+  }
+
+  std::vector <std::pair <std::string, Coefficient>>::const_iterator virtualTag;
+  for (virtualTag = virtualTagCoefficients.begin (); virtualTag != virtualTagCoefficients.end (); ++virtualTag)
+    if (hasTag (virtualTag->first))
+      matched.push_back (virtualTag->second);
+
+  std::sort (matched.begin (), matched.end ());
+  std::vector <Coefficient>::iterator m;
+  for (m = matched.begin (); m != matched.end (); ++m)
+    value += m->second;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Calculates the urgency of the given tasks that need it, as urgency_c would.
+// The input of each term is gathered for all tasks into a contiguous array, and
+// the polynomial is then summed one term at a time across the tasks, in the
+// order urgency_c uses, so that the results are identical and the summing
+// loops are simple enough for the compiler to vectorize.
+void Task::urgency_batch (std::vector <Task>& tasks, const std::vector <int>& order)
+{
+#ifdef PRODUCT_TASKWARRIOR
+  std::vector <Task*> stale;
+  std::vector <int>::const_iterator i;
+  for (i = order.begin (); i != order.end (); ++i)
+    if (tasks[*i].recalc_urgency)
+      stale.push_back (&tasks[*i]);
+
+  const size_t count = stale.size ();
+  if (count == 0)
+    return;
+
+  std::vector <float> value (count, 0.0);
+  std::vector <float> term (count);
+  std::vector <time_t> dates (count);
+
+  // Gathers one term for every task, then adds it to their values.
+  #define URGENCY_TERM(coefficient, gather)                      \
+  if (fabsf (coefficient) > epsilon)                             \
+  {                                                              \
+    for (size_t t = 0; t < count; ++t)                           \
+    {                                                            \
+      const Task& task = *stale[t];                              \
+      term[t] = (gather);                                        \
+    }                                                            \
+                                                                 \
+    const float c = coefficient;                                 \
+    for (size_t t = 0; t < count; ++t)                           \
+      value[t] += term[t] * c;                                   \
+  }
+
+  URGENCY_TERM (Task::urgencyPriorityCoefficient,    task.urgency_priority ());
+  URGENCY_TERM (Task::urgencyProjectCoefficient,     task.urgency_project ());
+  URGENCY_TERM (Task::urgencyActiveCoefficient,      task.urgency_active ());
+  URGENCY_TERM (Task::urgencyScheduledCoefficient,   task.urgency_scheduled ());
+  URGENCY_TERM (Task::urgencyWaitingCoefficient,     task.urgency_waiting ());
+  URGENCY_TERM (Task::urgencyBlockedCoefficient,     task.urgency_blocked ());
+  URGENCY_TERM (Task::urgencyAnnotationsCoefficient, task.urgency_annotations ());
+  URGENCY_TERM (Task::urgencyTagsCoefficient,        task.urgency_tags ());
+  URGENCY_TERM (Task::urgencyNextCoefficient,        task.urgency_next ());
+
+  // The date terms gather only the dates, and map them in a separate loop.
+  if (fabsf (Task::urgencyDueCoefficient) > epsilon)
+  {
+    for (size_t t = 0; t < count; ++t)
+    {
+      Task::const_iterator due = stale[t]->find ("due");
+      dates[t] = due != stale[t]->end () ? (time_t) due.number () : 0;
+      term[t]  = due != stale[t]->end () ? 1.0 : 0.0;
+    }
+
+    for (size_t t = 0; t < count; ++t)
+      term[t] = term[t] != 0.0 ? dueTerm (dates[t]) : 0.0;
+
+    const float c = Task::urgencyDueCoefficient;
+    for (size_t t = 0; t < count; ++t)
+      value[t] += term[t] * c;
+  }
+
+  URGENCY_TERM (Task::urgencyBlockingCoefficient,    task.urgency_blocking ());
+
+  if (fabsf (Task::urgencyAgeCoefficient) > epsilon)
+  {
+    for (size_t t = 0; t < count; ++t)
+    {
+      assert (stale[t]->has ("entry"));
+      dates[t] = stale[t]->get_date ("entry");
+    }
+
+    for (size_t t = 0; t < count; ++t)
+      term[t] = ageTerm (dates[t]);
+
+    const float c = Task::urgencyAgeCoefficient;
+    for (size_t t = 0; t < count; ++t)
+      value[t] += term[t] * c;
+  }
+
+  URGENCY_TERM (Task::urgencyInheritCoefficient,     task.urgency_inherit ());
+  #undef URGENCY_TERM
+
+  for (size_t t = 0; t < count; ++t)
+  {
+    stale[t]->urgency_user (value[t]);
+    stale[t]->urgency_value  = value[t];
+    stale[t]->recalc_urgency = false;
+  }
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 float Task::urgency_priority () const
 {
@@ -1760,30 +2323,7 @@ float Task::urgency_inherit () const
   if (!is_blocking)
     return 0.0;
 
-  // Calling dependencyGetBlocked is rather expensive.
-  // It is called recursively for each dependency in the chain here.
-  std::vector <Task> blocked;
-  dependencyGetBlocked (*this, blocked);
-
-  float v = 0.0;
-  std::vector <Task>::const_iterator it;
-  for (it = blocked.begin (); it != blocked.end (); ++it)
-  {
-    // urgency_blocked, _blocking, _project and _tags left out.
-    v += it->urgency_active ();
-    v += it->urgency_age ();
-    v += it->urgency_annotations ();
-    v += it->urgency_due ();
-    v += it->urgency_next ();
-    v += it->urgency_priority ();
-    v += it->urgency_scheduled ();
-    v += it->urgency_waiting ();
-
-    // Inherit from all parent tasks in the dependency chain recursively.
-    v += it->urgency_inherit ();
-  }
-
-  return v;
+  return context.tdb2.pending.inherited_urgency (get ("uuid"));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1808,7 +2348,7 @@ float Task::urgency_active () const
 float Task::urgency_scheduled () const
 {
   if (has ("scheduled") &&
-      get_date ("scheduled") < time (NULL))
+      get_date ("scheduled") < moments ().now)
     return 1.0;
 
   return 0.0;
@@ -1878,16 +2418,7 @@ float Task::urgency_next () const
 float Task::urgency_due () const
 {
   if (has ("due"))
-  {
-    Date now;
-    Date due (get_date ("due"));
-
-    // Map a range of 21 days to the value 0.2 - 1.0
-    float days_overdue = (now - due) / 86400.0;
-         if (days_overdue >= 7.0)   return 1.0;   // < 1 wk ago
-    else if (days_overdue >= -14.0) return ((days_overdue + 14.0) * 0.8 / 21.0) + 0.2;
-    else                            return 0.2;   // > 2 wks
-  }
+    return dueTerm (get_date ("due"));
 
   return 0.0;
 }
@@ -1897,14 +2428,7 @@ float Task::urgency_age () const
 {
   assert (has ("entry"));
 
-  Date now;
-  Date entry (get_date ("entry"));
-  int age = (now - entry) / 86400;  // in days
-
-  if (Task::urgencyAgeMax == 0 || age > Task::urgencyAgeMax)
-    return 1.0;
-
-  return (1.0 * age / Task::urgencyAgeMax);
+  return ageTerm (get_date ("entry"));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2000,7 +2524,7 @@ void Task::modify (modType type, bool text_required /* = false */)
             e.addSource (domSource);
             e.addSource (namedDates);
             e.ambiguity (false);
-            contextTask = *this;
+            setContextTask (*this);
 
             Variant v;
             e.evaluateInfixExpression (value, v);
@@ -2039,7 +2563,7 @@ void Task::modify (modType type, bool text_required /* = false */)
             e.addSource (domSource);
             e.addSource (namedDates);
             e.ambiguity (false);
-            contextTask = *this;
+            setContextTask (*this);
 
             Variant v;
             e.evaluateInfixExpression (value, v);
@@ -2061,7 +2585,7 @@ void Task::modify (modType type, bool text_required /* = false */)
             e.addSource (domSource);
             e.addSource (namedDates);
             e.ambiguity (false);
-            contextTask = *this;
+            setContextTask (*this);
 
             Variant v;
             e.evaluateInfixExpression (value, v);
@@ -2087,7 +2611,7 @@ void Task::modify (modType type, bool text_required /* = false */)
               e.addSource (domSource);
               e.addSource (namedDates);
               e.ambiguity (false);
-              contextTask = *this;
+              setContextTask (*this);
 
               Variant v;
               e.evaluateInfixExpression (value, v);
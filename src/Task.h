@@ -33,7 +33,99 @@
 #include <stdio.h>
 #include <time.h>
 
-class Task : public std::map <std::string, std::string>
+// The attributes of a task.  Attribute names are interned, so each is stored
+// once, and a task holds a vector of name/value slots ordered by name, which
+// is far cheaper to build, copy and search than a tree of nodes.  The
+// interface is the subset of std::map that Task has always offered.
+class Attributes
+{
+public:
+  struct Slot
+  {
+    const std::string* name;       // Interned
+    std::string        value;
+    mutable long long  number;     // Value as an integer, once parsed
+    mutable bool       parsed;
+  };
+
+  struct reference
+  {
+    const std::string& first;
+    std::string&       second;
+    reference* operator-> () { return this; }
+  };
+
+  struct const_reference
+  {
+    const std::string& first;
+    const std::string& second;
+    const const_reference* operator-> () const { return this; }
+  };
+
+  // Access through an iterator may modify the value, so it forgets the
+  // parsed number.
+  class iterator
+  {
+  public:
+    iterator () {}
+    iterator (std::vector <Slot>::iterator i) : _i (i) {}
+    reference operator* () const  { _i->parsed = false; reference r = {*_i->name, _i->value}; return r; }
+    reference operator-> () const { return **this; }
+    iterator& operator++ ()       { ++_i; return *this; }
+    iterator operator++ (int)     { iterator old (*this); ++_i; return old; }
+
+    std::vector <Slot>::iterator _i;
+  };
+
+  class const_iterator
+  {
+  public:
+    const_iterator () {}
+    const_iterator (std::vector <Slot>::const_iterator i) : _i (i) {}
+    const_iterator (const iterator& i) : _i (i._i) {}
+    const_reference operator* () const  { const_reference r = {*_i->name, _i->value}; return r; }
+    const_reference operator-> () const { return **this; }
+    const_iterator& operator++ ()       { ++_i; return *this; }
+    const_iterator operator++ (int)     { const_iterator old (*this); ++_i; return old; }
+    long long number () const;
+
+    std::vector <Slot>::const_iterator _i;
+  };
+
+  friend bool operator== (const const_iterator& left, const const_iterator& right) { return left._i == right._i; }
+  friend bool operator!= (const const_iterator& left, const const_iterator& right) { return left._i != right._i; }
+
+  iterator begin ()             { return _slots.begin (); }
+  iterator end ()               { return _slots.end ();   }
+  const_iterator begin () const { return _slots.begin (); }
+  const_iterator end () const   { return _slots.end ();   }
+  size_t size () const          { return _slots.size ();  }
+  bool empty () const           { return _slots.empty (); }
+  void clear ()                 { _slots.clear ();        }
+
+  iterator find (const std::string&);
+  const_iterator find (const std::string&) const;
+  size_t count (const std::string&) const;
+  std::string& operator[] (const std::string&);
+  void insert (const std::pair <const std::string, std::string>&);
+  iterator erase (iterator);
+  size_t erase (const std::string&);
+
+  // Appends an attribute that sorts after all the others, with its value
+  // already parsed, as when decoding a snapshot.
+  void append (const std::string*, const std::string&);
+  void append (const std::string*, const std::string&, long long);
+
+  static const std::string* intern (const std::string&);
+
+private:
+  std::vector <Slot>::iterator lookup (const std::string&);
+
+private:
+  std::vector <Slot> _slots;
+};
+
+class Task : public Attributes
 {
 public:
   static std::string defaultProject;
@@ -43,6 +135,7 @@ public:
   static bool regex;
   static std::map <std::string, std::string> attributes;  // name -> type
   static std::map <std::string, float> coefficients;
+  static void compileCoefficients ();
   static float urgencyPriorityCoefficient;
   static float urgencyProjectCoefficient;
   static float urgencyActiveCoefficient;
@@ -68,6 +161,7 @@ public:
 
   void parse (const std::string&);
   std::string composeF4 () const;
+  void composeF4 (std::string&) const;
   std::string composeJSON (bool decorate = false) const;
 
   // Status values.
@@ -89,6 +183,8 @@ public:
   // Series of helper functions.
   static status textToStatus (const std::string&);
   static std::string statusToText (status);
+  static bool isVirtualTag (const std::string&);
+  static bool isIndexedTag (const std::string&);
 
   void setAsNow (const std::string&);
   bool has (const std::string&) const;
@@ -125,6 +221,7 @@ public:
   void addTag (const std::string&);
   void addTags (const std::vector <std::string>&);
   void getTags (std::vector<std::string>&) const;
+  void getVirtualTags (std::vector<std::string>&) const;
   void removeTag (const std::string&);
 
   bool hasAnnotations () const;
@@ -151,6 +248,7 @@ public:
 
   float urgency_c () const;
   float urgency ();
+  static void urgency_batch (std::vector <Task>&, const std::vector <int>&);
 
   enum modType {modReplace, modPrepend, modAppend, modAnnotate};
   void modify (modType, bool text_required = false);
@@ -160,8 +258,8 @@ private:
   void parseJSON (const std::string&);
   void parseLegacy (const std::string&);
   void validate_before (const std::string&, const std::string&);
-  const std::string encode (const std::string&) const;
   const std::string decode (const std::string&) const;
+  void urgency_user (float&) const;
 
 public:
   float urgency_priority () const;
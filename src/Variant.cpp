@@ -955,7 +955,35 @@ bool Variant::operator!= (const Variant& other) const
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool Variant::operator_match (const Variant& other, const Task& task) const
+// Matches a string variant, and for descriptions the annotations, against a
+// regex.
+static bool matchRegex (const Variant& left, RX& r, const Task& task)
+{
+  if (r.match (left.get_string ()))
+    return true;
+
+  // If the above did not match, and the left source is "description", then
+  // in the annotations.
+  if (left.source () == "description")
+  {
+    std::map <std::string, std::string> annotations;
+    task.getAnnotations (annotations);
+
+    std::map <std::string, std::string>::iterator a;
+    for (a = annotations.begin (); a != annotations.end (); ++a)
+      if (r.match (a->second))
+        return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The pattern may be precompiled, in which case it must match 'other'.
+bool Variant::operator_match (
+  const Variant& other,
+  const Task& task,
+  RX* compiled /* = NULL */) const
 {
   // Simple matching case first.
   Variant left (*this);
@@ -975,22 +1003,11 @@ bool Variant::operator_match (const Variant& other, const Task& task) const
 
   if (searchUsingRegex)
   {
-    RX r (pattern, searchCaseSensitive);
-    if (r.match (left._string))
-      return true;
+    if (compiled)
+      return matchRegex (left, *compiled, task);
 
-    // If the above did not match, and the left source is "description", then
-    // in the annotations.
-    if (left.source () == "description")
-    {
-      std::map <std::string, std::string> annotations;
-      task.getAnnotations (annotations);
-
-      std::map <std::string, std::string>::iterator a;
-      for (a = annotations.begin (); a != annotations.end (); ++a)
-        if (r.match (a->second))
-          return true;
-    }
+    RX r (pattern, searchCaseSensitive);
+    return matchRegex (left, r, task);
   }
   else
   {
@@ -1015,9 +1032,12 @@ bool Variant::operator_match (const Variant& other, const Task& task) const
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool Variant::operator_nomatch (const Variant& other, const Task& task) const
+bool Variant::operator_nomatch (
+  const Variant& other,
+  const Task& task,
+  RX* compiled /* = NULL */) const
 {
-  return ! operator_match (other, task);
+  return ! operator_match (other, task, compiled);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1899,7 +1919,8 @@ Variant::operator std::string () const
 
   case type_date:
     {
-      struct tm* t = localtime (&_date);
+      struct tm local;
+      struct tm* t = localtime_r (&_date, &local);
 
       std::stringstream s;
       s.width (4);
@@ -2137,7 +2158,7 @@ void Variant::cast (const enum type new_type)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-int Variant::type ()
+int Variant::type () const
 {
   return _type;
 }
@@ -31,6 +31,8 @@
 #include <time.h>
 #include <Task.h>
 
+class RX;
+
 class Variant
 {
 public:
@@ -66,8 +68,8 @@ public:
   bool operator>= (const Variant&) const;
   bool operator== (const Variant&) const;
   bool operator!= (const Variant&) const;
-  bool operator_match (const Variant&, const Task&) const;
-  bool operator_nomatch (const Variant&, const Task&) const;
+  bool operator_match (const Variant&, const Task&, RX* = NULL) const;
+  bool operator_nomatch (const Variant&, const Task&, RX* = NULL) const;
   bool operator_partial (const Variant&) const;
   bool operator_nopartial (const Variant&) const;
   bool operator_hastag (const Variant&, const Task&) const;
@@ -96,7 +98,7 @@ public:
   void sqrt ();
 
   void cast (const enum type);
-  int type ();
+  int type () const;
   bool trivial () const;
 
   bool        get_bool () const;
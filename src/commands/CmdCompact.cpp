@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <Context.h>
+#include <main.h>
+#include <text.h>
+#include <i18n.h>
+#include <CmdCompact.h>
+
+extern Context context;
+
+////////////////////////////////////////////////////////////////////////////////
+CmdCompact::CmdCompact ()
+{
+  _keyword     = "compact";
+  _usage       = "task compact";
+  _description = STRING_CMD_COMPACT_USAGE;
+  _read_only   = false;
+  _displays_id = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rewrites the data files without the journal records and tombstones that have
+// since been superseded.  The files are written by the commit that follows.
+int CmdCompact::execute (std::string& output)
+{
+  context.tdb2.gc ();
+  int obsolete = context.tdb2.compact ();
+
+  if (context.verbose ("affected"))
+    output = format (STRING_CMD_COMPACT_DONE, obsolete) + "\n";
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -97,6 +97,15 @@ int CmdCustom::execute (std::string& output)
 
   sort_tasks (filtered, sequence, reportSort);
 
+  // Calculate urgency for the whole report at once, if it is shown.
+  std::vector <std::string>::iterator col;
+  for (col = columns.begin (); col != columns.end (); ++col)
+    if (col->substr (0, 7) == "urgency")
+    {
+      Task::urgency_batch (filtered, sequence);
+      break;
+    }
+
   // Configure the view.
   ViewTask view;
   view.width (context.getWidth ());
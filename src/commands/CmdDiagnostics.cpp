@@ -173,6 +173,12 @@ int CmdDiagnostics::execute (std::string& output)
 #else
       << " -tls"
 #endif
+
+#ifdef HAVE_LIBZ
+      << " +zlib"
+#else
+      << " -zlib"
+#endif
       << "\n";
 
   out << "    libuuid: "
@@ -337,6 +343,29 @@ int CmdDiagnostics::execute (std::string& output)
   else
     out << format ("             ({1})\n", STRING_CMD_DIAG_NONE);
 
+  // Latency of the hook scripts in recent commands.
+  std::map <std::string, std::vector <unsigned long> > latencies;
+  context.hooks.history (latencies);
+  out << "    Latency: ";
+  if (latencies.size ())
+  {
+    std::map <std::string, std::vector <unsigned long> >::iterator l;
+    for (l = latencies.begin (); l != latencies.end (); ++l)
+    {
+      std::sort (l->second.begin (), l->second.end ());
+      unsigned int last = l->second.size () - 1;
+      out << (l == latencies.begin () ? "" : "             ")
+          << l->first
+          << format (" p50 {1}s, p95 {2}s",
+                     trim (format (l->second[last * 50 / 100] / 1000000.0, 6, 3)),
+                     trim (format (l->second[last * 95 / 100] / 1000000.0, 6, 3)))
+          << format (" ({1} runs)", (int) l->second.size ())
+          << "\n";
+    }
+  }
+  else
+    out << format ("({1})\n", STRING_CMD_DIAG_NONE);
+
   out << "\n";
 
   // Verify UUIDs are all unique.
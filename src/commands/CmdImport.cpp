@@ -27,6 +27,7 @@
 #include <cmake.h>
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <Context.h>
 #include <JSON.h>
 #include <text.h>
@@ -37,6 +38,85 @@
 
 extern Context context;
 
+////////////////////////////////////////////////////////////////////////////////
+// Text that is not a whole JSON object, which fails with the parse error.
+static void rejectText (const std::string& text)
+{
+  delete json::parse (text);
+  throw std::string (STRING_TASK_PARSE_UNREC_FF);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the JSON objects from the file as they come, whether they are one per
+// line or spread over lines in an array.  Anything else between the objects,
+// other than the brackets and commas of an array, is rejected a line at a time.
+static void parseObjects (const std::string& file, std::vector <Task>& tasks)
+{
+  std::ifstream in (file.c_str (), std::ios::in | std::ios::binary);
+  if (! in.good ())
+    return;
+
+  std::string object;
+  int depth = 0;
+  bool quoted = false;
+  bool escaped = false;
+  bool stray = false;
+
+  char buffer[65536];
+  while (in.read (buffer, sizeof (buffer)) || in.gcount ())
+  {
+    std::streamsize length = in.gcount ();
+    for (std::streamsize i = 0; i < length; ++i)
+    {
+      char c = buffer[i];
+      if (depth)
+      {
+        object += c;
+        if (escaped)
+          escaped = false;
+        else if (quoted)
+        {
+          if (c == '\\')
+            escaped = true;
+          else if (c == '"')
+            quoted = false;
+        }
+        else if (c == '"')
+          quoted = true;
+        else if (c == '{')
+          ++depth;
+        else if (c == '}' && --depth == 0)
+        {
+          tasks.push_back (Task (object));
+          object = "";
+        }
+      }
+      else if (stray)
+      {
+        if (c == '\n')
+          rejectText (object);
+        else
+          object += c;
+      }
+      else if (c == '{')
+      {
+        object = c;
+        depth = 1;
+      }
+      else if (c != '['  && c != ']'  && c != ','  &&
+               c != ' '  && c != '\t' && c != '\r' && c != '\n')
+      {
+        object = c;
+        stray = true;
+      }
+    }
+  }
+
+  // An incomplete object, or stray text at the end.
+  if (object.length ())
+    rejectText (object);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CmdImport::CmdImport ()
 {
@@ -67,31 +147,19 @@ int CmdImport::execute (std::string& output)
 
     std::cout << format (STRING_CMD_IMPORT_FILE, *word) << "\n";
 
-    // Load the file.
-    std::vector <std::string> lines;
-    incoming.read (lines);
+    // Parse the whole thing, and add it all at once.
+    std::vector <Task> tasks;
+    parseObjects (*word, tasks);
+    context.tdb2.add (tasks);
 
-    std::vector <std::string>::iterator line;
-    for (line = lines.begin (); line != lines.end (); ++line)
+    std::vector <Task>::iterator task;
+    for (task = tasks.begin (); task != tasks.end (); ++task)
     {
-      std::string object = trimLeft (
-                             trimRight (
-                               trim (*line),
-                               "]"),
-                             "[");
-      // Skip blanks.  May be caused by the trim calls above.
-      if (! object.length ())
-        continue;
-
-      // Parse the whole thing.
-      Task task (object);
-
-      context.tdb2.add (task);
       ++count;
       std::cout << "  "
-                << task.get ("uuid")
+                << task->get ("uuid")
                 << " "
-                << task.get ("description")
+                << task->get ("description")
                 << "\n";
     }
   }
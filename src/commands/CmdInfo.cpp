@@ -71,11 +71,6 @@ int CmdInfo::execute (std::string& output)
     rc = 1;
   }
 
-  // Get the undo data.
-  std::vector <std::string> undo;
-  if (context.config.getBoolean ("journal.info"))
-    undo = context.tdb2.undo.get_lines ();
-
   // Determine the output date format, which uses a hierarchy of definitions.
   //   rc.dateformat.info
   //   rc.dateformat
@@ -314,32 +309,13 @@ int CmdInfo::execute (std::string& output)
 
     // Virtual tags.
     {
-      // Note: This list must match that in Task::hasTag.
+      std::vector <std::string> tags;
+      task->getVirtualTags (tags);
+
       std::string virtualTags = "";
-      if (task->hasTag ("ACTIVE"))    virtualTags += "ACTIVE ";
-      if (task->hasTag ("ANNOTATED")) virtualTags += "ANNOTATED ";
-      if (task->hasTag ("BLOCKED"))   virtualTags += "BLOCKED ";
-      if (task->hasTag ("BLOCKING"))  virtualTags += "BLOCKING ";
-      if (task->hasTag ("CHILD"))     virtualTags += "CHILD ";
-      if (task->hasTag ("COMPLETED")) virtualTags += "COMPLETED ";
-      if (task->hasTag ("DELETED"))   virtualTags += "DELETED ";
-      if (task->hasTag ("DUE"))       virtualTags += "DUE ";
-      if (task->hasTag ("DUETODAY"))  virtualTags += "DUETODAY ";
-      if (task->hasTag ("MONTH"))     virtualTags += "MONTH ";
-      if (task->hasTag ("OVERDUE"))   virtualTags += "OVERDUE ";
-      if (task->hasTag ("PARENT"))    virtualTags += "PARENT ";
-      if (task->hasTag ("PENDING"))   virtualTags += "PENDING ";
-      if (task->hasTag ("READY"))     virtualTags += "READY ";
-      if (task->hasTag ("SCHEDULED")) virtualTags += "SCHEDULED ";
-      if (task->hasTag ("TAGGED"))    virtualTags += "TAGGED ";
-      if (task->hasTag ("TODAY"))     virtualTags += "TODAY ";
-      if (task->hasTag ("TOMORROW"))  virtualTags += "TOMORROW ";
-      if (task->hasTag ("UNBLOCKED")) virtualTags += "UNBLOCKED ";
-      if (task->hasTag ("UNTIL"))     virtualTags += "UNTIL ";
-      if (task->hasTag ("WAITING"))   virtualTags += "WAITING ";
-      if (task->hasTag ("WEEK"))      virtualTags += "WEEK ";
-      if (task->hasTag ("YEAR"))      virtualTags += "YEAR ";
-      if (task->hasTag ("YESTERDAY")) virtualTags += "YESTERDAY ";
+      std::vector <std::string>::iterator tag;
+      for (tag = tags.begin (); tag != tags.end (); ++tag)
+        virtualTags += *tag + " ";
 
       row = view.addRow ();
       view.set (row, 0, STRING_CMD_INFO_VIRTUAL_TAGS);
@@ -494,8 +470,10 @@ int CmdInfo::execute (std::string& output)
     journal.add (Column::factory ("string", STRING_COLUMN_LABEL_DATE));
     journal.add (Column::factory ("string", STRING_CMD_INFO_MODIFICATION));
 
+    // Only the transactions of this task are read from the undo data.
+    std::vector <std::string> undo;
     if (context.config.getBoolean ("journal.info") &&
-        undo.size () > 3)
+        context.tdb2.undo.get_transactions (uuid, undo))
     {
       // Scan the undo data for entries matching this task.
       std::string when;
@@ -515,15 +493,26 @@ int CmdInfo::execute (std::string& output)
 
         if (current.find ("uuid:\"" + uuid) != std::string::npos)
         {
-          if (previous != "")
+          // A delta holds only the changed attributes, which is all that is
+          // compared.
+          bool delta = current.compare (0, 6, "delta ") == 0;
+          if (previous != "" || delta)
           {
             int row = journal.addRow ();
 
             Date timestamp (strtol (when.substr (5).c_str (), NULL, 10));
             journal.set (row, 0, timestamp.toString (dateformat));
 
-            Task before (previous.substr (4));
-            Task after (current.substr (4));
+            Task before;
+            Task after;
+            if (delta)
+              TDB2::parseDelta (current.substr (6), before, after);
+            else
+            {
+              before.parse (previous.substr (4));
+              after.parse (current.substr (4));
+            }
+
             journal.set (row, 1, taskInfoDifferences (before, after, dateformat, last_timestamp, timestamp.toEpoch()));
           }
         }
@@ -60,19 +60,15 @@ int CmdProjects::execute (std::string& output)
   handleRecurrence ();
   std::vector <Task> tasks = context.tdb2.pending.get_tasks ();
 
-  if (context.config.getBoolean ("list.all.projects"))
-  {
-    std::vector <Task> extra = context.tdb2.completed.get_tasks ();
-    std::vector <Task>::iterator task;
-    for (task = extra.begin (); task != extra.end (); ++task)
-      tasks.push_back (*task);
-  }
-
-  // Apply the filter.
+  // Apply the filter.  Only the project and status of completed tasks are
+  // needed, which the completed.data index provides.
   Filter filter;
   std::vector <Task> filtered;
   filter.subset (tasks, filtered);
 
+  if (context.config.getBoolean ("list.all.projects"))
+    filter.subsetCompleted (filtered, true);
+
   int quantity = filtered.size ();
 
   std::stringstream out;
@@ -185,19 +181,15 @@ int CmdCompletionProjects::execute (std::string& output)
   handleRecurrence ();
   std::vector <Task> tasks = context.tdb2.pending.get_tasks ();
 
-  if (context.config.getBoolean ("list.all.projects"))
-  {
-    std::vector <Task> extra = context.tdb2.completed.get_tasks ();
-    std::vector <Task>::iterator task;
-    for (task = extra.begin (); task != extra.end (); ++task)
-      tasks.push_back (*task);
-  }
-
-  // Apply the filter.
+  // Apply the filter.  Only the project and status of completed tasks are
+  // needed, which the completed.data index provides.
   Filter filter;
   std::vector <Task> filtered;
   filter.subset (tasks, filtered);
 
+  if (context.config.getBoolean ("list.all.projects"))
+    filter.subsetCompleted (filtered, true);
+
   // Scan all the tasks for their project name, building a map using project
   // names as keys.
   std::map <std::string, int> unique;
@@ -128,6 +128,9 @@ int CmdShow::execute (std::string& output)
     " complete.all.tags"
     " confirmation"
     " context"
+    " data.journal"
+    " data.journal.compact"
+    " data.tombstones"
     " data.location"
     " dateformat"
     " dateformat.annotation"
@@ -156,9 +159,15 @@ int CmdShow::execute (std::string& output)
     " editor"
     " exit.on.missing.db"
     " expressions"
+    " filter.threads"
     " fontunderline"
     " gc"
     " hooks"
+    " hooks.parallel"
+    " hooks.persistent"
+    " hooks.timeout"
+    " hooks.timeout.total"
+    " hooks.latency"
     " hyphenate"
     " indent.annotation"
     " indent.report"
@@ -183,6 +192,7 @@ int CmdShow::execute (std::string& output)
     " rule.precedence.color"
     " search.case.sensitive"
     " shell.prompt"
+    " snapshot"
     " tag.indicator"
     " taskd.server"
     " taskd.ca"
@@ -191,6 +201,10 @@ int CmdShow::execute (std::string& output)
     " taskd.credentials"
     " taskd.key"
     " taskd.trust"
+    " undo.compress"
+    " undo.delta"
+    " undo.retention"
+    " undo.segment.size"
     " undo.style"
     " urgency.active.coefficient"
     " urgency.scheduled.coefficient"
@@ -58,23 +58,21 @@ int CmdStats::execute (std::string& output)
 
   std::string dateformat = context.config.get ("dateformat");
 
+  // Count the undo transactions, including the undo segments.
+  int undoCount = 0;
+  size_t undoSize = 0;
+  context.tdb2.undo_statistics (undoCount, undoSize);
+
   // Go get the file sizes.
   size_t dataSize = context.tdb2.pending._file.size ()
                   + context.tdb2.completed._file.size ()
-                  + context.tdb2.undo._file.size ()
+                  + undoSize
                   + context.tdb2.backlog._file.size ();
 
-  // Count the undo transactions.
-  std::vector <std::string> undoTxns = context.tdb2.undo.get_lines ();
-  int undoCount = 0;
-  std::vector <std::string>::iterator tx;
-  for (tx = undoTxns.begin (); tx != undoTxns.end (); ++tx)
-    if (*tx == "---")
-      ++undoCount;
-
   // Count the backlog transactions.
   std::vector <std::string> backlogTxns = context.tdb2.backlog.get_lines ();
   int backlogCount = 0;
+  std::vector <std::string>::iterator tx;
   for (tx = backlogTxns.begin (); tx != backlogTxns.end (); ++tx)
     if ((*tx)[0] == '{')
       ++backlogCount;
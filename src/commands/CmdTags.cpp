@@ -55,22 +55,17 @@ int CmdTags::execute (std::string& output)
 
   // Get all the tasks.
   std::vector <Task> tasks = context.tdb2.pending.get_tasks ();
-
-  if (context.config.getBoolean ("list.all.tags"))
-  {
-    std::vector <Task> extra = context.tdb2.completed.get_tasks ();
-    std::vector <Task>::iterator task;
-    for (task = extra.begin (); task != extra.end (); ++task)
-      tasks.push_back (*task);
-  }
-
   int quantity = tasks.size ();
 
-  // Apply filter.
+  // Apply filter.  Only the tags of completed tasks are needed, which the
+  // completed.data index provides.
   Filter filter;
   std::vector <Task> filtered;
   filter.subset (tasks, filtered);
 
+  if (context.config.getBoolean ("list.all.tags"))
+    quantity += filter.subsetCompleted (filtered, true);
+
   // Scan all the tasks for their project name, building a map using project
   // names as keys.
   std::map <std::string, int> unique;
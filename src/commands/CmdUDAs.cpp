@@ -135,7 +135,7 @@ int CmdUDAs::execute (std::string& output)
   std::vector <Task>::iterator i;
   for (i = filtered.begin (); i != filtered.end (); ++i)
   {
-    std::map <std::string, std::string>::iterator att;
+    Task::const_iterator att;
     for (att = i->begin (); att != i->end (); ++att)
       if (att->first.substr (0, 11) != "annotation_" &&
           context.columns.find (att->first) == context.columns.end ())
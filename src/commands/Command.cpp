@@ -45,6 +45,7 @@
 #include <CmdColor.h>
 #include <CmdColumns.h>
 #include <CmdCommands.h>
+#include <CmdCompact.h>
 #include <CmdConfig.h>
 #include <CmdContext.h>
 #include <CmdCount.h>
@@ -106,6 +107,7 @@ void Command::factory (std::map <std::string, Command*>& all)
   c = new CmdCalendar ();           all[c->keyword ()] = c;
   c = new CmdColor ();              all[c->keyword ()] = c;
   c = new CmdColumns ();            all[c->keyword ()] = c;
+  c = new CmdCompact ();            all[c->keyword ()] = c;
   c = new CmdCompletionAliases ();  all[c->keyword ()] = c;
   c = new CmdCompletionColumns ();  all[c->keyword ()] = c;
   c = new CmdCompletionCommands (); all[c->keyword ()] = c;
@@ -40,32 +40,13 @@ extern Context context;
 ////////////////////////////////////////////////////////////////////////////////
 void dependencyGetBlocked (const Task& task, std::vector <Task>& blocked)
 {
-  std::string uuid = task.get ("uuid");
-
-  const std::vector <Task>& all = context.tdb2.pending.get_tasks ();
-  std::vector <Task>::const_iterator it;
-  for (it = all.begin (); it != all.end (); ++it)
-    if ((it->getStatus () == Task::pending  ||
-         it->getStatus () == Task::waiting) &&
-        it->has ("depends")                 &&
-        it->get ("depends").find (uuid) != std::string::npos)
-      blocked.push_back (*it);
+  context.tdb2.pending.get_blocked (task.get ("uuid"), blocked);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void dependencyGetBlocking (const Task& task, std::vector <Task>& blocking)
 {
-  std::string depends = task.get ("depends");
-  if (depends != "")
-  {
-    const std::vector <Task>& all = context.tdb2.pending.get_tasks ();
-    std::vector <Task>::const_iterator it;
-    for (it = all.begin (); it != all.end (); ++it)
-      if ((it->getStatus () == Task::pending  ||
-           it->getStatus () == Task::waiting) &&
-          depends.find (it->get ("uuid")) != std::string::npos)
-        blocking.push_back (*it);
-  }
+  context.tdb2.pending.get_blocking (task, blocking);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
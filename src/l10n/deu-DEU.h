@@ -553,6 +553,8 @@
 #define STRING_CMD_COLOR_RAMP        "Grauskala"
 #define STRING_CMD_COLOR_TRY         "Versuchen Sie '{1}' auszuführen."
 #define STRING_CMD_COLOR_OFF         "Farben wurden in Ihrer .taskrc-Datei deaktiviert.  Um zie zu aktivieren, löschen Sie die Zeile 'color=off' oder ändern Sie 'off' zu 'on'."
+#define STRING_CMD_COMPACT_USAGE     "Removes obsolete records from the data files"
+#define STRING_CMD_COMPACT_DONE      "Compacted the data files, removing {1} obsolete records."
 #define STRING_CMD_CONFIG_USAGE      "task-Konfiguration verändern"
 #define STRING_CMD_CONFIG_CONFIRM    "Wirklich die Option '{1}' von '{2}' zu '{3}' ändern?"
 #define STRING_CMD_CONFIG_CONFIRM2   "Wirklich die Option '{1}' mit Wert '{2}' hinzufügen?"
@@ -828,6 +830,8 @@
 #define STRING_HOOK_ERROR_SAME1      "Hook Error: JSON must be for the same task: {1}"
 #define STRING_HOOK_ERROR_SAME2      "Hook Error: JSON must be for the same task: {1} != {2}"
 #define STRING_HOOK_ERROR_NOFEEDBACK "Hook Error: Expected feedback from a failing hook script."
+#define STRING_HOOK_ERROR_NOREPLY    "Hook Error: Persistent hook script '{1}' did not reply to event {2}."
+#define STRING_HOOK_ERROR_TIMEOUT    "Hook Error: '{1}' did not finish within {2} seconds, and was stopped."
 
 // JSON
 #define STRING_JSON_MISSING_VALUE    "Fehler: Fehlender Wert nach ',' an Position {1}"
@@ -883,6 +887,7 @@
 
 // TDB2
 #define STRING_TDB2_PARSE_ERROR      " in {1} in Zeile {2}"
+#define STRING_TDB2_WRITE_ERROR      "Could not write to '{1}'."
 #define STRING_TDB2_UUID_NOT_UNIQUE  "Kann Aufgabe nicht hinzufügen, weil UUID '{1}' nicht eindeutig ist."
 #define STRING_TDB2_MISSING          "Fehlendes                     {1}  \"{2}\""
 #define STRING_TDB2_NO_UNDO          "Keine rückgängig zu machenden Transaktionen."
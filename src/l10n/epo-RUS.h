@@ -553,6 +553,8 @@
 #define STRING_CMD_COLOR_RAMP        "Gray ramp"
 #define STRING_CMD_COLOR_TRY         "Try running '{1}'."
 #define STRING_CMD_COLOR_OFF         "Color is currently turned off in your .taskrc file.  To enable color, remove the line 'color=off', or change the 'off' to 'on'."
+#define STRING_CMD_COMPACT_USAGE     "Removes obsolete records from the data files"
+#define STRING_CMD_COMPACT_DONE      "Compacted the data files, removing {1} obsolete records."
 #define STRING_CMD_CONFIG_USAGE      "Change settings in the task configuration"
 #define STRING_CMD_CONFIG_CONFIRM    "Are you sure you want to change the value of '{1}' from '{2}' to '{3}'?"
 #define STRING_CMD_CONFIG_CONFIRM2   "Are you sure you want to add '{1}' with a value of '{2}'?"
@@ -828,6 +830,8 @@
 #define STRING_HOOK_ERROR_SAME1      "Hook Error: JSON must be for the same task: {1}"
 #define STRING_HOOK_ERROR_SAME2      "Hook Error: JSON must be for the same task: {1} != {2}"
 #define STRING_HOOK_ERROR_NOFEEDBACK "Hook Error: Expected feedback from a failing hook script."
+#define STRING_HOOK_ERROR_NOREPLY    "Hook Error: Persistent hook script '{1}' did not reply to event {2}."
+#define STRING_HOOK_ERROR_TIMEOUT    "Hook Error: '{1}' did not finish within {2} seconds, and was stopped."
 
 // JSON
 #define STRING_JSON_MISSING_VALUE    "Eraro: mankas valoro post ',' ĉe pozicio {1}"
@@ -883,6 +887,7 @@
 
 // TDB2
 #define STRING_TDB2_PARSE_ERROR      " en {1} ĉe vico {2}"
+#define STRING_TDB2_WRITE_ERROR      "Could not write to '{1}'."
 #define STRING_TDB2_UUID_NOT_UNIQUE  "Ne povis krei la taskon ĉar UUID-identigilo '{}' ne estas unika."
 #define STRING_TDB2_MISSING          "Mankanta                      {1}  \"{2}\""
 #define STRING_TDB2_NO_UNDO          "Ne estas nenia registrita ago por malfari."
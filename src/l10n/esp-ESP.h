@@ -562,6 +562,8 @@
 #define STRING_CMD_COLOR_TRY         "Intente ejecutar '{1}'."
 //#define STRING_CMD_COLOR_TRY         "Try running '{1}'."
 #define STRING_CMD_COLOR_OFF         "El color está actualmente desactivado en su archivo .taskrc . Para activar el color elimine la línea 'color=off', o cambie el 'off' a 'on'."
+#define STRING_CMD_COMPACT_USAGE     "Removes obsolete records from the data files"
+#define STRING_CMD_COMPACT_DONE      "Compacted the data files, removing {1} obsolete records."
 #define STRING_CMD_CONFIG_USAGE      "Cambia los ajustes en la configuración de task"
 #define STRING_CMD_CONFIG_CONFIRM    "¿Está seguro de querer cambiar el valor de '{1}' de '{2}' a '{3}'?"
 #define STRING_CMD_CONFIG_CONFIRM2   "¿Está seguro de querer añadir '{1}' con un valor de '{2}'?"
@@ -837,6 +839,8 @@
 #define STRING_HOOK_ERROR_SAME1      "Hook Error: JSON must be for the same task: {1}"
 #define STRING_HOOK_ERROR_SAME2      "Hook Error: JSON must be for the same task: {1} != {2}"
 #define STRING_HOOK_ERROR_NOFEEDBACK "Hook Error: Expected feedback from a failing hook script."
+#define STRING_HOOK_ERROR_NOREPLY    "Hook Error: Persistent hook script '{1}' did not reply to event {2}."
+#define STRING_HOOK_ERROR_TIMEOUT    "Hook Error: '{1}' did not finish within {2} seconds, and was stopped."
 
 // JSON
 #define STRING_JSON_MISSING_VALUE    "Error: falta valor después de ',' en posición {1}"
@@ -892,6 +896,7 @@
 
 // TDB2
 #define STRING_TDB2_PARSE_ERROR      " en {1} en la línea {2}"
+#define STRING_TDB2_WRITE_ERROR      "Could not write to '{1}'."
 #define STRING_TDB2_UUID_NOT_UNIQUE  "No se puede añadir la tarea porque el uuid '{1}' no es único."
 
 #define STRING_TDB2_MISSING          "Falta                         {1}  \"{2}\""
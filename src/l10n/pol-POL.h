@@ -553,6 +553,8 @@
 #define STRING_CMD_COLOR_RAMP        "Odcienie szarości"
 #define STRING_CMD_COLOR_TRY         "Spróbuj wykonać '{1}'."
 #define STRING_CMD_COLOR_OFF         "Aktualnie, kolorowanie jest wyłączone w twoim pliku .taskrc. Aby włączyć kolorowanie, usuń linie 'color=off', lub zmień wartość 'off' na 'on'."
+#define STRING_CMD_COMPACT_USAGE     "Removes obsolete records from the data files"
+#define STRING_CMD_COMPACT_DONE      "Compacted the data files, removing {1} obsolete records."
 #define STRING_CMD_CONFIG_USAGE      "Zmienia konfigurację programu"
 #define STRING_CMD_CONFIG_CONFIRM    "Czy na pewno chcesz zmienić wartość '{1}' z '{2}' na '{3}'?"
 #define STRING_CMD_CONFIG_CONFIRM2   "Czy na pewno chcesz dodać '{1}' z wartością '{2}'?"
@@ -828,6 +830,8 @@
 #define STRING_HOOK_ERROR_SAME1      "Hook Error: JSON must be for the same task: {1}"
 #define STRING_HOOK_ERROR_SAME2      "Hook Error: JSON must be for the same task: {1} != {2}"
 #define STRING_HOOK_ERROR_NOFEEDBACK "Hook Error: Expected feedback from a failing hook script."
+#define STRING_HOOK_ERROR_NOREPLY    "Hook Error: Persistent hook script '{1}' did not reply to event {2}."
+#define STRING_HOOK_ERROR_TIMEOUT    "Hook Error: '{1}' did not finish within {2} seconds, and was stopped."
 
 // JSON
 #define STRING_JSON_MISSING_VALUE    "Błąd: brak wartości po ',' na pozycji {1}"
@@ -883,6 +887,7 @@
 
 // TDB2
 #define STRING_TDB2_PARSE_ERROR      " w {1} w lini {2}"
+#define STRING_TDB2_WRITE_ERROR      "Could not write to '{1}'."
 #define STRING_TDB2_UUID_NOT_UNIQUE  "Nie można dodać zadania ponieważ uuid '{1}' nie jest unikalny."
 #define STRING_TDB2_MISSING          "Brakuje                       {1}  \"{2}\""
 #define STRING_TDB2_NO_UNDO          "Nie ma żadnych zapisanych transakcji do cofnięcia."
@@ -37,8 +37,40 @@
 
 extern Context context;
 
-static std::vector <Task>* global_data = NULL;
-static std::vector <std::string> global_keys;
+// How the values of one sort key are compared.
+enum sortKind
+{
+  sortNumber,      // urgency, id, numeric UDAs
+  sortDepends,     // ID of the first dependency, no dependencies first
+  sortString,      // strings, dates and string/date UDAs
+  sortPriority,    // H, M, L, then none
+  sortDue,         // due dates, tasks without a due date last
+  sortDuration,    // durations, by length when they differ
+  sortNone,        // UDAs of other types, never decides
+  sortInvalid      // not a sort field, an error once compared
+};
+
+struct sortKey
+{
+  sortKind kind;
+  std::string field;
+  bool ascending;
+};
+
+// The value of one sort key for one task.  Strings are not copied, but point
+// into the task itself, which is not modified while sorting.  Strings, dates
+// and priorities are also reduced to a rank, so that they compare as numbers.
+struct sortValue
+{
+  const std::string* text;
+  double number;
+};
+
+static std::vector <sortKey> global_keys;
+static std::vector <sortValue> global_values;
+static void sort_keys (const std::string&);
+static void sort_values (Task&, sortValue*);
+static void sort_ranks (const std::vector <int>&, size_t);
 static bool sort_compare (int, int);
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -49,75 +81,209 @@ void sort_tasks (
 {
   context.timer_sort.start ();
 
-  global_data = &data;
-
-  // Split the key defs.
-  global_keys.clear ();
-  split (global_keys, keys, ',');
-
   // Only sort if necessary.
   if (order.size ())
+  {
+    sort_keys (keys);
+
+    // Urgency is calculated for all the tasks at once, up front.
+    std::vector <sortKey>::iterator k;
+    for (k = global_keys.begin (); k != global_keys.end (); ++k)
+    {
+      if (k->field == "urgency")
+      {
+        Task::urgency_batch (data, order);
+        break;
+      }
+    }
+
+    // Extract the sort keys of each task once, so that comparisons only look
+    // at the extracted values.
+    global_values.resize (data.size () * global_keys.size ());
+    std::vector <int>::iterator i;
+    for (i = order.begin (); i != order.end (); ++i)
+      sort_values (data[*i], &global_values[*i * global_keys.size ()]);
+
+    for (size_t k = 0; k < global_keys.size (); ++k)
+      if (global_keys[k].kind == sortString ||
+          global_keys[k].kind == sortDue)
+        sort_ranks (order, k);
+
     std::stable_sort (order.begin (), order.end (), sort_compare);
+  }
 
   context.timer_sort.stop ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Re-implementation, using direct Task access instead of data copies that
-// require re-parsing.
-//
-// Essentially a static implementation of a dynamic operator<.
-static bool sort_compare (int left, int right)
+// Decodes the comma-separated sort definition into keys.
+static void sort_keys (const std::string& keys)
 {
-  std::string field;
-  bool ascending;
-  bool breakIndicator;
-  Column* column;
-  int left_number;
-  int right_number;
-  float left_real;
-  float right_real;
-  char left_char;
-  char right_char;
-
-  std::vector <std::string>::iterator k;
-  for (k = global_keys.begin (); k != global_keys.end (); ++k)
+  std::vector <std::string> fields;
+  split (fields, keys, ',');
+
+  global_keys.clear ();
+  std::vector <std::string>::iterator f;
+  for (f = fields.begin (); f != fields.end (); ++f)
   {
-    context.decomposeSortField (*k, field, ascending, breakIndicator);
+    sortKey key;
+    bool breakIndicator;
+    context.decomposeSortField (*f, key.field, key.ascending, breakIndicator);
+
+    if (key.field == "urgency" ||
+        key.field == "id")
+      key.kind = sortNumber;
+
+    else if (key.field == "depends")
+      key.kind = sortDepends;
+
+    else if (key.field == "description" ||
+             key.field == "project"     ||
+             key.field == "status"      ||
+             key.field == "tags"        ||
+             key.field == "uuid"        ||
+             key.field == "end"         ||
+             key.field == "entry"       ||
+             key.field == "start"       ||
+             key.field == "until"       ||
+             key.field == "wait")
+      key.kind = sortString;
+
+    else if (key.field == "priority")
+      key.kind = sortPriority;
+
+    else if (key.field == "due")
+      key.kind = sortDue;
+
+    else if (key.field == "recur")
+      key.kind = sortDuration;
 
-    // Urgency.
-    if (field == "urgency")
+    // UDAs.
+    else
     {
-      left_real  = (*global_data)[left].urgency ();
-      right_real = (*global_data)[right].urgency ();
+      key.kind = sortInvalid;
 
-      if (left_real == right_real)
-        continue;
+      std::map <std::string, Column*>::iterator column = context.columns.find (key.field);
+      if (column != context.columns.end () && column->second != NULL)
+      {
+        std::string type = column->second->type ();
+             if (type == "numeric")  key.kind = sortNumber;
+        else if (type == "string")   key.kind = sortString;
+        else if (type == "date")     key.kind = sortString;
+        else if (type == "duration") key.kind = sortDuration;
+        else                         key.kind = sortNone;
+      }
+    }
 
-      return ascending ? (left_real < right_real)
-                       : (left_real > right_real);
+    global_keys.push_back (key);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Extracts the value of every sort key from a task.
+static void sort_values (Task& task, sortValue* value)
+{
+  std::vector <sortKey>::iterator k;
+  for (k = global_keys.begin (); k != global_keys.end (); ++k, ++value)
+  {
+    value->text   = &task.get_ref (k->field);
+    value->number = 0.0;
+
+    if (k->field == "urgency")
+      value->number = task.urgency ();
+
+    else if (k->field == "id")
+      value->number = task.id;
+
+    else if (k->kind == sortNumber)
+      value->number = strtof (value->text->c_str (), NULL);
+
+    // Sort on the first dependency.
+    else if (k->kind == sortDepends)
+    {
+      if (*value->text != "")
+        value->number = context.tdb2.id (value->text->substr (0, 36));
     }
 
-    // Number.
-    else if (field == "id")
+    // H, M, L and none rank 3 to 0.
+    else if (k->kind == sortPriority)
     {
-      left_number  = (*global_data)[left].id;
-      right_number = (*global_data)[right].id;
+      const char priority = (*value->text)[0];
+      value->number = priority == 'H' ? 3 :
+                      priority == 'M' ? 2 :
+                      priority == 'L' ? 1 : 0;
+    }
 
+    else if (k->kind == sortDuration)
+      value->number = (time_t) Duration (*value->text);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool sort_text (const sortValue* left, const sortValue* right)
+{
+  return *left->text < *right->text;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Replaces the strings of one sort key by their rank among all the distinct
+// strings of that key, so each string is compared once here rather than on
+// every comparison.  The empty string ranks 0, all others from 1 up.
+static void sort_ranks (const std::vector <int>& order, size_t key)
+{
+  std::vector <sortValue*> values;
+  values.reserve (order.size ());
+  std::vector <int>::const_iterator i;
+  for (i = order.begin (); i != order.end (); ++i)
+    values.push_back (&global_values[*i * global_keys.size () + key]);
+
+  std::sort (values.begin (), values.end (), sort_text);
+
+  double rank = 0;
+  const std::string* previous = NULL;
+  std::vector <sortValue*>::iterator v;
+  for (v = values.begin (); v != values.end (); ++v)
+  {
+    if (previous ? *(*v)->text != *previous : *(*v)->text != "")
+      ++rank;
+
+    (*v)->number = rank;
+    previous = (*v)->text;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Compares the extracted sort keys of two tasks.
+//
+// Essentially a static implementation of a dynamic operator<.
+static bool sort_compare (int left, int right)
+{
+  const sortValue* left_value  = &global_values[left  * global_keys.size ()];
+  const sortValue* right_value = &global_values[right * global_keys.size ()];
+
+  std::vector <sortKey>::iterator k;
+  for (k = global_keys.begin ();
+       k != global_keys.end ();
+       ++k, ++left_value, ++right_value)
+  {
+    const bool ascending = k->ascending;
+    const std::string& left_string  = *left_value->text;
+    const std::string& right_string = *right_value->text;
+    const double left_number  = left_value->number;
+    const double right_number = right_value->number;
+
+    switch (k->kind)
+    {
+    // Numbers, including urgency.
+    case sortNumber:
       if (left_number == right_number)
         continue;
 
       return ascending ? (left_number < right_number)
                        : (left_number > right_number);
-    }
 
     // Depends string.
-    else if (field == "depends")
-    {
-      // Raw data is a comma-separated list of uuids
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
-
+    case sortDepends:
       if (left_string == right_string)
         continue;
 
@@ -127,157 +293,49 @@ static bool sort_compare (int left, int right)
       if (left_string != "" && right_string == "")
         return !ascending;
 
-      // Sort on the first dependency.
-      left_number  = context.tdb2.id (left_string.substr (0, 36));
-      right_number = context.tdb2.id (right_string.substr (0, 36));
-
       if (left_number == right_number)
         continue;
 
       return ascending ? (left_number < right_number)
                        : (left_number > right_number);
-    }
-
-    // String.
-    else if (field == "description" ||
-             field == "project"     ||
-             field == "status"      ||
-             field == "tags"        ||
-             field == "uuid")
-    {
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
-
-      if (left_string == right_string)
-        continue;
-
-      return ascending ? (left_string < right_string)
-                       : (left_string > right_string);
-    }
 
-    // Priority.
-    else if (field == "priority")
-    {
-      left_char  = ((*global_data)[left].get  (field))[0];
-      right_char = ((*global_data)[right].get (field))[0];
-
-      if (left_char == right_char)
+    // String, or date, by rank.  Priority, by rank.
+    case sortString:
+    case sortPriority:
+      if (left_number == right_number)
         continue;
 
-      if (ascending)
-        return (left_char == '\0'  && right_char != '\0')                           ||
-               (left_char == 'L' && (right_char == 'M' || right_char == 'H')) ||
-               (left_char == 'M' && right_char == 'H');
-
-      return (left_char != '\0'  && right_char == '\0')                           ||
-             (left_char == 'M' && right_char == 'L')                          ||
-             (left_char == 'H' && (right_char == 'M' || right_char == 'L'));
-    }
-
-    // Due Date.
-    else if (field == "due")
-    {
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
+      return ascending ? (left_number < right_number)
+                       : (left_number > right_number);
 
-      if (left_string != "" && right_string == "")
+    // Due Date, by rank, where rank 0 is no due date.
+    case sortDue:
+      if (left_number != 0 && right_number == 0)
         return true;
 
-      if (left_string == "" && right_string != "")
+      if (left_number == 0 && right_number != 0)
         return false;
 
-      if (left_string == right_string)
-        continue;
-
-      return ascending ? (left_string < right_string)
-                       : (left_string > right_string);
-    }
-
-    // Date.
-    else if (field == "end"   ||
-             field == "entry" ||
-             field == "start" ||
-             field == "until" ||
-             field == "wait")
-    {
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
-
-      if (left_string == right_string)
+      if (left_number == right_number)
         continue;
 
-      return ascending ? (left_string < right_string)
-                       : (left_string > right_string);
-    }
+      return ascending ? (left_number < right_number)
+                       : (left_number > right_number);
 
     // Duration.
-    else if (field == "recur")
-    {
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
-
+    case sortDuration:
       if (left_string == right_string)
         continue;
 
-      Duration left_duration (left_string);
-      Duration right_duration (right_string);
-      return ascending ? (left_duration < right_duration)
-                       : (left_duration > right_duration);
-    }
-
-    // UDAs.
-    else if ((column = context.columns[field]) != NULL)
-    {
-      std::string type = column->type ();
-      if (type == "numeric")
-      {
-        const float left_real  = strtof (((*global_data)[left].get_ref  (field)).c_str (), NULL);
-        const float right_real = strtof (((*global_data)[right].get_ref (field)).c_str (), NULL);
-
-        if (left_real == right_real)
-          continue;
-
-        return ascending ? (left_real < right_real)
-                         : (left_real > right_real);
-      }
-      else if (type == "string")
-      {
-        const std::string& left_string  = (*global_data)[left].get_ref  (field);
-        const std::string& right_string = (*global_data)[right].get_ref (field);
-
-        if (left_string == right_string)
-          continue;
-
-        return ascending ? (left_string < right_string)
-                         : (left_string > right_string);
-      }
-      else if (type == "date")
-      {
-        const std::string& left_string  = (*global_data)[left].get_ref  (field);
-        const std::string& right_string = (*global_data)[right].get_ref (field);
-
-        if (left_string == right_string)
-          continue;
-
-        return ascending ? (left_string < right_string)
-                         : (left_string > right_string);
-      }
-      else if (type == "duration")
-      {
-        const std::string& left_string  = (*global_data)[left].get_ref  (field);
-        const std::string& right_string = (*global_data)[right].get_ref (field);
+      return ascending ? (left_number < right_number)
+                       : (left_number > right_number);
 
-        if (left_string == right_string)
-          continue;
+    case sortNone:
+      continue;
 
-        Duration left_duration (left_string);
-        Duration right_duration (right_string);
-        return ascending ? (left_duration < right_duration)
-                         : (left_duration > right_duration);
-      }
+    case sortInvalid:
+      throw format (STRING_INVALID_SORT_COL, k->field);
     }
-    else
-      throw format (STRING_INVALID_SORT_COL, field);
   }
 
   return false;
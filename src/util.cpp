@@ -263,12 +263,24 @@ int flock (int fd, int operation)
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
-// Run a binary with args, capturing output.
+// The seconds left of the timeout since start.
+static double remaining (const struct timeval& start, double timeout)
+{
+  struct timeval now;
+  gettimeofday (&now, NULL);
+  return timeout - (now.tv_sec  - start.tv_sec)
+                 - (now.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run a binary with args, capturing output.  If it is still running after the
+// timeout, in seconds, it is killed, and -1 is returned.
 int execute (
   const std::string& executable,
   const std::vector <std::string>& args,
   const std::string& input,
-  std::string& output)
+  std::string& output,
+  double timeout /* = 0.0 */)
 {
   pid_t pid;
   int pin[2], pout[2];
@@ -324,10 +336,28 @@ int execute (
     close (pin[1]);
   }
 
+  struct timeval start;
+  gettimeofday (&start, NULL);
+
   read_retval = -1;
   written = 0;
   while (read_retval != 0 || input.size () != written)
   {
+    if (timeout > 0.0 &&
+        remaining (start, timeout) <= 0.0)
+    {
+      kill (pid, SIGKILL);
+      if (input.size () != written)
+        close (pin[1]);
+      close (pout[0]);
+      waitpid (pid, NULL, 0);
+
+      if (signal (SIGPIPE, SIG_DFL) == SIG_ERR)
+        throw std::string (std::strerror (errno));
+
+      return -1;
+    }
+
     FD_ZERO (&rfds);
     if (read_retval != 0)
     {
@@ -343,6 +373,13 @@ int execute (
     tv.tv_sec = 5;
     tv.tv_usec = 0;
 
+    // Wake up in time to enforce the timeout.
+    if (timeout > 0.0)
+    {
+      tv.tv_sec  = 0;
+      tv.tv_usec = 100000;
+    }
+
     select_retval = select (std::max (pout[0], pin[1]) + 1, &rfds, &wfds, NULL, &tv);
 
     if (select_retval == -1)
@@ -386,8 +423,32 @@ int execute (
 
   close (pout[0]);  // Close the read end of the output pipe.
 
+  // A child that closed its output may still be running, so with a timeout its
+  // exit is polled for, and it is killed once the time is up.
   int status = -1;
-  if (wait (&status) == -1)
+  if (timeout > 0.0)
+  {
+    pid_t exited;
+    while ((exited = waitpid (pid, &status, WNOHANG)) == 0)
+    {
+      if (remaining (start, timeout) <= 0.0)
+      {
+        kill (pid, SIGKILL);
+        waitpid (pid, NULL, 0);
+
+        if (signal (SIGPIPE, SIG_DFL) == SIG_ERR)
+          throw std::string (std::strerror (errno));
+
+        return -1;
+      }
+
+      usleep (1000);
+    }
+
+    if (exited == -1)
+      throw std::string (std::strerror (errno));
+  }
+  else if (waitpid (pid, &status, 0) == -1)
     throw std::string (std::strerror (errno));
 
   if (WIFEXITED (status))
@@ -405,6 +466,63 @@ int execute (
   return status;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Start a binary with args, and leave it running.  The returned descriptors
+// are connected to its standard input and output, and are not inherited by
+// any later children.
+pid_t launch (
+  const std::string& executable,
+  const std::vector <std::string>& args,
+  int& input,
+  int& output)
+{
+  pid_t pid;
+  int pin[2], pout[2];
+
+  if (pipe (pin) == -1)
+    throw std::string (std::strerror (errno));
+
+  if (pipe (pout) == -1)
+    throw std::string (std::strerror (errno));
+
+  if ((pid = fork ()) == -1)
+    throw std::string (std::strerror (errno));
+
+  if (pid == 0)
+  {
+    // This is only reached in the child
+    close (pin[1]);   // Close the write end of the input pipe.
+    close (pout[0]);  // Close the read end of the output pipe.
+
+    if (dup2 (pin[0], STDIN_FILENO) == -1)
+      throw std::string (std::strerror (errno));
+    close (pin[0]);
+
+    if (dup2 (pout[1], STDOUT_FILENO) == -1)
+      throw std::string (std::strerror (errno));
+    close (pout[1]);
+
+    char** argv = new char* [args.size () + 2];
+    argv[0] = (char*) executable.c_str ();
+    for (unsigned int i = 0; i < args.size (); ++i)
+      argv[i+1] = (char*) args[i].c_str ();
+
+    argv[args.size () + 1] = NULL;
+    _exit (execvp (executable.c_str (), argv));
+  }
+
+  // This is only reached in the parent
+  close (pin[0]);   // Close the read end of the input pipe.
+  close (pout[1]);  // Close the write end of the output pipe.
+
+  fcntl (pin[1],  F_SETFD, FD_CLOEXEC);
+  fcntl (pout[0], F_SETFD, FD_CLOEXEC);
+
+  input  = pin[1];
+  output = pout[0];
+  return pid;
+}
+
 // Collides with std::numeric_limits methods
 #undef max
 
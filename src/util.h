@@ -50,7 +50,8 @@ void uuid_unparse_lower (uuid_t uu, char *out);
 #endif
 const std::string uuid ();
 
-int execute (const std::string&, const std::vector <std::string>&, const std::string&, std::string&);
+int execute (const std::string&, const std::vector <std::string>&, const std::string&, std::string&, double timeout = 0.0);
+pid_t launch (const std::string&, const std::vector <std::string>&, int&, int&);
 
 #ifdef SOLARIS
   #define LOCK_SH 1
@@ -0,0 +1,116 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+################################################################################
+##
+## Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+##
+## Permission is hereby granted, free of charge, to any person obtaining a copy
+## of this software and associated documentation files (the "Software"), to deal
+## in the Software without restriction, including without limitation the rights
+## to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+## copies of the Software, and to permit persons to whom the Software is
+## furnished to do so, subject to the following conditions:
+##
+## The above copyright notice and this permission notice shall be included
+## in all copies or substantial portions of the Software.
+##
+## THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+## OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+## FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+## THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+## LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+## OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+## SOFTWARE.
+##
+## http://www.opensource.org/licenses/mit-license.php
+##
+################################################################################
+
+import sys
+import os
+import unittest
+# Ensure python finds the local simpletap and basetest modules
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+
+from basetest import Task, TestCase
+
+
+class TestJournal(TestCase):
+    def setUp(self):
+        """Executed before each test in the class"""
+        self.t = Task()
+        self.t.config("data.journal", "on")
+        self.t.config("data.journal.compact", "0")
+
+        self.t(("add", "one"))
+        self.t(("add", "two"))
+        self.t(("add", "three"))
+
+    def lines(self, name):
+        with open(os.path.join(self.t.datadir, name)) as fh:
+            return fh.read().splitlines()
+
+    def test_modify_appends(self):
+        """Modifications are appended, and replayed in place"""
+        self.t(("2", "modify", "+tag"))
+        pending = self.lines("pending.data")
+        self.assertEqual(len(pending), 4)
+        self.assertTrue(pending[-1].startswith('journal ['))
+
+        code, out, err = self.t(("_get", "2.description", "2.tags"))
+        self.assertEqual(out, "two tag\n")
+
+    def test_journal_attribute(self):
+        """An attribute named 'journal' is kept, and can be a UDA"""
+        path = os.path.join(self.t.datadir, "import.json")
+        with open(path, "w") as fh:
+            fh.write('{"description":"four","journal":"foo","status":"pending","entry":"20150101T000000Z"}\n')
+
+        self.t(("import", path))
+        self.t(("4", "modify", "+tag"))
+        code, out, err = self.t(("4", "export"))
+        self.assertIn('"journal":"foo"', out)
+
+        self.t.config("uda.journal.type", "string")
+        code, out, err = self.t(("_get", "4.journal"))
+        self.assertEqual(out, "foo\n")
+
+    def test_done_appends(self):
+        """Completed tasks leave a tombstone in pending.data"""
+        self.t(("1", "done"))
+        self.t(("list",))
+        pending = self.lines("pending.data")
+        self.assertEqual(len(pending), 5)
+        self.assertTrue(pending[-1].startswith('relocated ['))
+        self.assertEqual(len(self.lines("completed.data")), 1)
+
+        code, out, err = self.t(("_get", "1.description", "2.description"))
+        self.assertEqual(out, "two three\n")
+
+    def test_compact(self):
+        """The compact command removes obsolete records"""
+        self.t(("2", "modify", "+tag"))
+        self.t(("1", "done"))
+        code, out, err = self.t(("compact",))
+        self.assertIn("removing 3 obsolete records", out)
+        self.assertEqual(len(self.lines("pending.data")), 2)
+
+        code, out, err = self.t(("_get", "1.description", "1.tags"))
+        self.assertEqual(out, "two tag\n")
+
+    def test_auto_compact(self):
+        """Data files are compacted beyond the configured threshold"""
+        self.t.config("data.journal.compact", "50")
+        self.t(("1", "modify", "+tag"))
+        self.assertEqual(len(self.lines("pending.data")), 4)
+        self.t(("2", "modify", "+tag"))
+        self.assertEqual(len(self.lines("pending.data")), 5)
+        self.t(("list",))
+        self.assertEqual(len(self.lines("pending.data")), 3)
+
+
+if __name__ == "__main__":
+    from simpletap import TAPTestRunner
+    unittest.main(testRunner=TAPTestRunner())
+
+# vim: ai sts=4 et sw=4
@@ -43,10 +43,39 @@ bool get (const std::string& name, Variant& value)
   return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Only 'x' is known for partial evaluation.
+bool known (const std::string& name)
+{
+  return name == "x";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// 'y' resolves to slot 0, 'x' is constant.
+int resolve (const std::string& name)
+{
+  if (name == "y")
+    return 0;
+
+  if (name == "x")
+    return Eval::constant;
+
+  return Eval::variable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int fetches = 0;
+bool fetch (int slot, Variant& value)
+{
+  ++fetches;
+  value = Variant (41);
+  return slot == 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 int main (int argc, char** argv)
 {
-  UnitTest t (52);
+  UnitTest t (63);
 
   // Test the source independently.
   Variant v;
@@ -163,6 +192,48 @@ int main (int argc, char** argv)
   t.is (result.type (), Variant::type_duration, "infix '- 2days' --> duration");
   t.is (result.get_duration (), -86400*2,      "infix '- 2days' --> -86400 * 2");
 
+  // Partial evaluation, 'y' is unknown.
+  Eval p1;
+  p1.addSource (get);
+  p1.compileExpression ("x and y");
+  t.notok (p1.evaluatePartialExpression (result, known), "partial 'x and y' --> undecided");
+
+  Eval p2;
+  p2.addSource (get);
+  p2.compileExpression ("! x and y");
+  t.ok (p2.evaluatePartialExpression (result, known),    "partial '! x and y' --> decided");
+  t.is (result.get_bool (), false,                       "partial '! x and y' --> false");
+
+  Eval p3;
+  p3.addSource (get);
+  p3.compileExpression ("y or x");
+  t.ok (p3.evaluatePartialExpression (result, known),    "partial 'y or x' --> decided");
+  t.is (result.get_bool (), true,                        "partial 'y or x' --> true");
+
+  Eval p4;
+  p4.addSource (get);
+  p4.compileExpression ("! y");
+  t.notok (p4.evaluatePartialExpression (result, known), "partial '! y' --> undecided");
+
+  // Resolved identifiers.
+  Eval r1;
+  r1.addSource (get);
+  r1.addResolver (resolve, fetch);
+  r1.compileExpression ("y + 1");
+  r1.evaluateCompiledExpression (result);
+  r1.evaluateCompiledExpression (result);
+  t.is (result.get_integer (), 42,             "resolved 'y + 1' --> 42");
+  t.is (fetches, 2,                            "resolved 'y + 1' --> slot fetched per evaluation");
+
+  Eval r2;
+  r2.addSource (get);
+  r2.addResolver (resolve, fetch);
+  r2.compileExpression ("x and true");
+  r2.evaluateCompiledExpression (result);
+  t.is (result.type (), Variant::type_boolean, "resolved 'x and true' --> boolean");
+  t.is (result.get_bool (), true,              "resolved 'x and true' --> true");
+  t.is (fetches, 2,                            "resolved 'x and true' --> constant not fetched");
+
   return 0;
 }
 
@@ -26,6 +26,9 @@
 
 #include <cmake.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include <Context.h>
 #include <File.h>
 #include <Directory.h>
@@ -35,7 +38,7 @@ Context context;
 
 int main (int argc, char** argv)
 {
-  UnitTest t (27);
+  UnitTest t (35);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -92,6 +95,55 @@ int main (int argc, char** argv)
   f8.remove ();
   t.notok (f8.exists (),                 "File::remove perm file no longer exists");
 
+  // bool replace (const std::string&);
+  File f9 ("tmp/file.t.replace.txt");
+  f9.create (0600);
+  File f10 ("tmp/file.t.replace.txt");
+  f10.open ();
+  f9.open ();
+  f9.lock ();
+  t.ok (f9.replace ("one\ntwo\n"),       "File::replace did not fail");
+  t.is (File::read ("tmp/file.t.replace.txt"), "one\ntwo\n", "File::replace new contents");
+  t.is ((int) (f9.mode () & 0777), 0600, "File::replace keeps permissions");
+  t.notok (File ("tmp/file.t.replace.txt.tmp").exists (), "File::replace leaves no temporary file");
+  f9.append ("three\n");
+  f9.close ();
+  t.is (File::read ("tmp/file.t.replace.txt"), "one\ntwo\nthree\n", "File::replace leaves the new file open");
+
+  // A lock acquired on the replaced file is moved to the new file.
+  std::string contents;
+  t.ok (f10.lock (),                     "File::lock after replace did not fail");
+  f10.read (contents);
+  t.is (contents, "one\ntwo\nthree\n",  "File::lock after replace reads new contents");
+  f10.close ();
+
+  // Killing a writer leaves either the old or the new contents.
+  std::string old_contents = std::string (1 << 20, 'a') + "\n";
+  std::string new_contents = std::string (1 << 20, 'b') + "\n";
+  File::write ("tmp/file.t.replace.txt", old_contents);
+  bool intact = true;
+  for (int i = 0; i < 10 && intact; ++i)
+  {
+    pid_t pid = fork ();
+    if (pid == 0)
+    {
+      File writer ("tmp/file.t.replace.txt");
+      while (true)
+        writer.replace ((i % 2) ? old_contents : new_contents);
+    }
+
+    usleep (1000 * (i + 1));
+    kill (pid, SIGKILL);
+    waitpid (pid, NULL, 0);
+
+    contents = File::read ("tmp/file.t.replace.txt");
+    intact = contents == old_contents || contents == new_contents;
+  }
+
+  t.ok (intact,                          "File::replace killed mid-write leaves a whole file");
+  File::remove ("tmp/file.t.replace.txt.tmp");
+  f9.remove ();
+
   tmp.remove ();
   t.notok (tmp.exists (),                "tmp dir removed.");
 
@@ -59,6 +59,90 @@ class TestHooksOnAdd(TestCase):
         code, out, err = self.t(("1", "info"))
         self.assertIn("Description   foo", out)
 
+    def test_onadd_batch_import(self):
+        """on-add-batch-accept - called once for all imported tasks."""
+        self.t.hooks.add_default('on-add-accept', log=True)
+        self.t.hooks.add_default('on-add-batch-accept', log=True)
+
+        path = os.path.join(self.t.datadir, 'import.json')
+        with open(path, 'w') as fh:
+            for n in range(3):
+                fh.write('{"description":"task%d","status":"pending"}\n' % n)
+
+        code, out, err = self.t(("import", path))
+        self.assertIn("Imported 3 tasks", err)
+
+        self.t.hooks['on-add-accept'].assertTriggeredCount(3)
+
+        hook = self.t.hooks['on-add-batch-accept']
+        hook.assertTriggeredCount(1)
+        hook.assertExitcode(0)
+        self.assertEqual(len(hook.get_logs()["input"]["json"]), 3)
+
+        # A single add is not a batch.
+        code, out, err = self.t(("add", "foo"))
+        self.t.hooks['on-add-accept'].assertTriggeredCount(4)
+        hook.assertTriggeredCount(1)
+
+    def test_onadd_timeout(self):
+        """on-add script running beyond hooks.timeout is stopped"""
+        self.t.hooks.add('on-add.slow', """#!/bin/sh
+sleep 10
+exit 0
+""")
+
+        code, out, err = self.t.runError(("rc.hooks.timeout:0.3", "add", "foo"), timeout=5)
+        self.assertIn("'on-add.slow' did not finish within 0.3 seconds", err)
+
+    def test_onadd_timeout_closed_output(self):
+        """on-add script that closes its output is still stopped by hooks.timeout"""
+        self.t.hooks.add('on-add.quiet', """#!/bin/sh
+read task
+echo $task
+exec >&-
+sleep 10
+exit 0
+""")
+
+        code, out, err = self.t.runError(("rc.hooks.timeout:0.3", "add", "foo"), timeout=5)
+        self.assertIn("'on-add.quiet' did not finish within 0.3 seconds", err)
+
+        code, out, err = self.t(("rc.hooks:off", "count"))
+        self.assertEqual(out.strip(), "0")
+
+    def test_onadd_timeout_total(self):
+        """on-add scripts beyond hooks.timeout.total are stopped"""
+        for name in ('on-add.a', 'on-add.b'):
+            self.t.hooks.add(name, """#!/bin/sh
+read new_task
+sleep 0.4
+echo $new_task
+exit 0
+""")
+
+        code, out, err = self.t.runError(("rc.hooks.timeout.total:0.6", "add", "foo"), timeout=5)
+        self.assertIn("'on-add.b' did not finish within", err)
+
+    def test_onadd_latency(self):
+        """on-add script latency is summarized by diagnostics"""
+        self.t.hooks.add_default('on-add-accept')
+        self.t.hooks.add_default('on-launch-good')
+
+        # Off by default.
+        self.t(("add", "foo"))
+        self.assertFalse(os.path.exists(os.path.join(self.t.datadir, "hooks.latency")))
+
+        self.t.config("hooks.latency", "on")
+        self.t(("add", "bar"))
+        self.t(("add", "baz"))
+
+        # Read-only commands do not record.
+        self.t(("list",))
+
+        code, out, err = self.t.diag()
+        self.assertRegexpMatches(out, "Latency: on-add-accept p50 [0-9.]+s, p95 [0-9.]+s \(2 runs\)")
+        self.assertRegexpMatches(out, "on-launch-good p50 [0-9.]+s, p95 [0-9.]+s \(2 runs\)")
+
     def test_onadd_builtin_reject(self):
         """on-add-reject - a well-behaved, failing, on-add hook."""
         hookname = 'on-add-reject'
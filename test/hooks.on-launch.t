@@ -57,6 +57,48 @@ class TestHooksOnLaunch(TestCase):
         logs = hook.get_logs()
         self.assertEqual(logs["output"]["msgs"][0], "FEEDBACK")
 
+    def test_onlaunch_parallel(self):
+        """on-launch scripts run concurrently"""
+        # Each script waits for the other, so they only finish if they run at
+        # the same time.
+        for name, mine, other in (('on-launch.a', 'a', 'b'), ('on-launch.b', 'b', 'a')):
+            self.t.hooks.add(name, """#!/bin/sh
+cd $(dirname $0)
+touch %s.started
+for n in 1 2 3 4 5 6 7 8 9 10; do
+  [ -f %s.started ] && echo 'MET' && exit 0
+  sleep 0.1
+done
+echo 'ALONE'
+exit 0
+""" % (mine, other))
+
+        code, out, err = self.t(("rc.hooks.parallel:2", "rc.debug:1", "version"))
+        self.assertNotIn("ALONE", err)
+        self.assertIn("Perf hook on-launch.a", err)
+        self.assertIn("Perf hook on-launch.b", err)
+
+    def test_onlaunch_timeout(self):
+        """on-launch script running beyond hooks.timeout is stopped"""
+        self.t.hooks.add('on-launch.slow', """#!/bin/sh
+sleep 10
+exit 0
+""")
+
+        code, out, err = self.t.runError(("rc.hooks.timeout:0.3", "version"), timeout=5)
+        self.assertIn("'on-launch.slow' did not finish within 0.3 seconds", err)
+
+    def test_onlaunch_timeout_closed_output(self):
+        """on-launch script that closes its output is still stopped by hooks.timeout"""
+        self.t.hooks.add('on-launch.quiet', """#!/bin/sh
+exec >&-
+sleep 10
+exit 0
+""")
+
+        code, out, err = self.t.runError(("rc.hooks.timeout:0.3", "version"), timeout=5)
+        self.assertIn("'on-launch.quiet' did not finish within 0.3 seconds", err)
+
     def test_onlaunch_builtin_bad(self):
         """on-launch-bad - a well-behaved, failing, on-launch hook."""
         hookname = 'on-launch-bad'
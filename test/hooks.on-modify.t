@@ -61,6 +61,67 @@ class TestHooksOnModify(TestCase):
         self.assertIn("Description   foo", out)
         self.assertIn("Tags          tag", out)
 
+    def test_onmodify_batch_bulk(self):
+        """on-modify-batch-accept - called once for all modified tasks."""
+        self.t.hooks.add_default('on-modify-accept', log=True)
+        self.t.hooks.add_default('on-modify-batch-accept', log=True)
+
+        for n in range(3):
+            self.t(("add", "task%d" % n))
+        self.t(("rc.bulk:0", "1-3", "modify", "+tag"))
+
+        self.t.hooks['on-modify-accept'].assertTriggeredCount(3)
+
+        hook = self.t.hooks['on-modify-batch-accept']
+        hook.assertTriggeredCount(1)
+        hook.assertExitcode(0)
+        self.assertEqual(len(hook.get_logs()["input"]["json"]), 6)
+
+        code, out, err = self.t(("+tag", "count"))
+        self.assertEqual(out.strip(), "3")
+
+    def test_onmodify_batch_amend(self):
+        """on-modify-batch changes are saved, and undone with the modification."""
+        self.t.hooks.add('on-modify-batch.amend', """#!/bin/sh
+while read original_task
+do
+  read modified_task
+  echo $modified_task | sed 's/"description":"foo"/"description":"bar"/'
+done
+exit 0
+""")
+
+        self.t(("add", "foo"))
+        self.t.hooks.add_default('on-exit-good', log=True)
+        self.t(("1", "modify", "+tag"))
+
+        # The amended task replaces the modification, rather than adding to it.
+        changes = self.t.hooks['on-exit-good'].get_logs()["input"]["json"]
+        self.assertEqual(len(changes), 1)
+        self.assertEqual(changes[0]["description"], "bar")
+
+        code, out, err = self.t(("_get", "1.description", "1.tags"))
+        self.assertEqual(out.strip(), "bar tag")
+
+        self.t(("undo",))
+        code, out, err = self.t(("_get", "1.description", "1.tags"))
+        self.assertEqual(out.strip(), "foo")
+
+    def test_onmodify_batch_reject(self):
+        """on-modify-batch rejection discards all modifications."""
+        self.t.hooks.add('on-modify-batch.reject', """#!/bin/sh
+echo 'REJECTED'
+exit 1
+""")
+
+        for n in range(2):
+            self.t(("add", "task%d" % n))
+        code, out, err = self.t.runError(("1-2", "modify", "+tag"))
+        self.assertIn("REJECTED", err)
+
+        code, out, err = self.t(("+tag", "count"))
+        self.assertEqual(out.strip(), "0")
+
     def test_onmodify_builtin_reject(self):
         """on-modify-reject - a well-behaved, failing, on-modify hook."""
         hookname = 'on-modify-reject'
@@ -0,0 +1,151 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+################################################################################
+##
+## Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+##
+## Permission is hereby granted, free of charge, to any person obtaining a copy
+## of this software and associated documentation files (the "Software"), to deal
+## in the Software without restriction, including without limitation the rights
+## to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+## copies of the Software, and to permit persons to whom the Software is
+## furnished to do so, subject to the following conditions:
+##
+## The above copyright notice and this permission notice shall be included
+## in all copies or substantial portions of the Software.
+##
+## THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+## OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+## FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+## THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+## LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+## OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+## SOFTWARE.
+##
+## http://www.opensource.org/licenses/mit-license.php
+##
+################################################################################
+
+import sys
+import os
+import unittest
+# Ensure python finds the local simpletap and basetest modules
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+
+from basetest import Task, TestCase
+
+# Replies to each event with the last task, its description amended, and logs
+# the process and sequence number of the event.
+ACCEPT = """#!/usr/bin/env python
+import json, os, sys
+log = open(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'events.log'), 'a')
+for line in iter(sys.stdin.readline, ''):
+    event = json.loads(line)
+    log.write('%d %d %s\\n' % (os.getpid(), event['seq'], sys.argv[-1]))
+    log.flush()
+    task = event['tasks'][-1]
+    task['description'] += ' seen'
+    print(json.dumps(task))
+    print(json.dumps({'seq': event['seq'], 'status': 0}))
+    sys.stdout.flush()
+"""
+
+REJECT = """#!/usr/bin/env python
+import json, sys
+for line in iter(sys.stdin.readline, ''):
+    event = json.loads(line)
+    print('REJECTED')
+    print(json.dumps({'seq': event['seq'], 'status': 1}))
+    sys.stdout.flush()
+"""
+
+SILENT = """#!/bin/sh
+read event
+"""
+
+
+class TestHooksPersistent(TestCase):
+    def setUp(self):
+        """Executed before each test in the class"""
+        self.t = Task()
+        self.t.activate_hooks()
+
+    def events(self):
+        with open(os.path.join(self.t.datadir, 'hooks', 'events.log')) as fh:
+            return [line.split() for line in fh]
+
+    def test_persistent_modify(self):
+        """A persistent on-modify script handles all events of a command"""
+        self.t.hooks.add('on-modify.persistent', ACCEPT)
+        self.t.config('hooks.persistent', 'on-modify.persistent')
+
+        for n in range(3):
+            self.t(("add", "task%d" % n))
+        self.t(("rc.bulk:0", "1-3", "modify", "+x"))
+
+        events = self.events()
+        self.assertEqual(len(events), 3)
+        self.assertEqual(len(set(e[0] for e in events)), 1)
+        self.assertEqual([e[1] for e in events], ["1", "2", "3"])
+        self.assertEqual(events[0][2], "mode:persistent")
+
+        code, out, err = self.t(("+x", "count"))
+        self.assertEqual(out.strip(), "3")
+        code, out, err = self.t(("/seen/", "count"))
+        self.assertEqual(out.strip(), "3")
+
+    def test_persistent_add(self):
+        """A persistent on-add script handles all tasks of an import"""
+        self.t.hooks.add('on-add.persistent', ACCEPT)
+        self.t.config('hooks.persistent', 'on-add.persistent')
+
+        path = os.path.join(self.t.datadir, 'import.json')
+        with open(path, 'w') as fh:
+            for n in range(3):
+                fh.write('{"description":"task%d","status":"pending"}\n' % n)
+
+        code, out, err = self.t(("import", path))
+        self.assertIn("Imported 3 tasks", err)
+
+        events = self.events()
+        self.assertEqual(len(events), 3)
+        self.assertEqual(len(set(e[0] for e in events)), 1)
+
+        code, out, err = self.t(("/seen/", "count"))
+        self.assertEqual(out.strip(), "3")
+
+    def test_persistent_reject(self):
+        """A persistent script rejects an event through the reply status"""
+        self.t.hooks.add('on-modify.persistent', REJECT)
+        self.t.config('hooks.persistent', 'on-modify.persistent')
+
+        self.t(("add", "foo"))
+        code, out, err = self.t.runError(("1", "modify", "+x"))
+        self.assertIn("REJECTED", err)
+
+        code, out, err = self.t(("+x", "count"))
+        self.assertEqual(out.strip(), "0")
+
+    def test_persistent_noreply(self):
+        """A persistent script that does not reply is an error"""
+        self.t.hooks.add('on-modify.persistent', SILENT)
+        self.t.config('hooks.persistent', 'on-modify.persistent')
+
+        self.t(("add", "foo"))
+        code, out, err = self.t.runError(("1", "modify", "+x"))
+        self.assertIn("did not reply to event 1", err)
+
+    def test_not_persistent(self):
+        """Scripts not listed as persistent are run once per event"""
+        self.t.hooks.add('on-modify.persistent', ACCEPT)
+
+        self.t(("add", "foo"))
+        code, out, err = self.t.runError(("1", "modify", "+x"))
+        self.assertIn("Hook Error", err)
+
+
+if __name__ == "__main__":
+    from simpletap import TAPTestRunner
+    unittest.main(testRunner=TAPTestRunner())
+
+# vim: ai sts=4 et sw=4
@@ -27,7 +27,7 @@
 
 use strict;
 use warnings;
-use Test::More tests => 9;
+use Test::More tests => 13;
 
 # Ensure environment has no influence.
 delete $ENV{'TASKDATA'};
@@ -96,7 +96,51 @@ $output = qx{../src/task rc:import.rc import import2.txt 2>&1 >/dev/null};
 like ($output, qr/Imported 1 tasks\./, 'no errors');
 # Imported 1 tasks successfully.
 
+# Create an import file holding a JSON array, spread over lines.
+if (open my $fh, '>', 'import3.txt')
+{
+  print $fh <<EOF;
+[
+  {
+    "uuid": "55555555-5555-5555-5555-555555555555",
+    "description": "four {with} \\"braces\\"",
+    "status": "pending",
+    "entry": "1234567889"
+  },
+  {
+    "uuid": "66666666-6666-6666-6666-666666666666",
+    "description": "five",
+    "status": "pending",
+    "entry": "1234567889"
+  }
+]
+EOF
+  close $fh;
+}
+
+$output = qx{../src/task rc:import.rc import import3.txt 2>&1 >/dev/null};
+like ($output, qr/Imported 2 tasks\./, 'multi-line array: no errors');
+
+$output = qx{../src/task rc:import.rc _get 4.description 5.description 2>&1};
+like ($output, qr/^four \{with\} "braces" five$/m, 'multi-line array: both tasks present');
+
+# Make sure that a uuid cannot be imported twice from one file.
+if (open my $fh, '>', 'import4.txt')
+{
+  print $fh <<EOF;
+{"uuid":"77777777-7777-7777-7777-777777777777","description":"six","status":"pending","entry":"1234567889"}
+{"uuid":"77777777-7777-7777-7777-777777777777","description":"seven","status":"pending","entry":"1234567889"}
+EOF
+  close $fh;
+}
+
+$output = qx{../src/task rc:import.rc import import4.txt 2>&1 >/dev/null};
+like ($output, qr/Cannot add task because the uuid .+ is not unique\./, 'error on duplicate uuid within file');
+
+$output = qx{../src/task rc:import.rc count 2>&1};
+like ($output, qr/^6$/m, 'duplicate uuid within file: nothing imported');
+
 # Cleanup.
-unlink qw(import.txt import2.txt pending.data completed.data undo.data backlog.data  import.rc);
+unlink qw(import.txt import2.txt import3.txt import4.txt pending.data completed.data undo.data backlog.data  import.rc);
 exit 0;
 
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cmake.h>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <main.h>
+#include <test.h>
+
+Context context;
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int argc, char** argv)
+{
+  UnitTest t (16);
+
+  try
+  {
+    unlink ("./snapshot.data");
+    unlink ("./snapshot.data.snapshot");
+
+    File text ("./snapshot.data");
+    text.write ("[description:\"one\" entry:\"1234567890\" status:\"pending\" uuid:\"a\"]\n"
+                "[annotation_1234567891:\"note\" description:\"two\" due:\"20150101\" status:\"pending\" uuid:\"b\"]\n");
+    text.flush ();
+
+    std::vector <Task> tasks;
+    tasks.push_back (Task ("[description:\"one\" entry:\"1234567890\" status:\"pending\" uuid:\"a\"]"));
+    tasks.push_back (Task ("[annotation_1234567891:\"note\" description:\"two\" due:\"20150101\" status:\"pending\" uuid:\"b\"]"));
+
+    Snapshot snapshot;
+    snapshot.target ("./snapshot.data.snapshot");
+
+    std::vector <Task> loaded;
+    t.notok (snapshot.load (text, loaded), "Snapshot: missing snapshot not loaded");
+
+    std::vector <unsigned long long> lines;
+    lines.push_back (0);
+    lines.push_back (72);
+    t.ok (snapshot.save (text, tasks, 0, &lines), "Snapshot: saved");
+    t.ok (snapshot.current (text), "Snapshot: current after save");
+    unsigned long long saved = File (text._data).size ();
+
+    std::vector <unsigned long long> loaded_lines;
+    t.ok (snapshot.load (text, loaded, &loaded_lines), "Snapshot: loaded");
+    t.is ((int) loaded_lines.size (), 2, "Snapshot: 2 line offsets loaded");
+    t.ok (loaded_lines[1] == 72, "Snapshot: line offset round trip");
+    t.is ((int) loaded.size (), 2, "Snapshot: 2 tasks loaded");
+    t.ok (loaded[0] == tasks[0], "Snapshot: task 1 round trip");
+    t.ok (loaded[1] == tasks[1], "Snapshot: task 2 round trip");
+    t.is (loaded[0].get ("entry"), "1234567890", "Snapshot: date round trip");
+    t.is (loaded[1].annotation_count, 1, "Snapshot: annotation counted");
+
+    // A modified text file invalidates the snapshot.
+    text.append ("[description:\"three\" status:\"pending\" uuid:\"c\"]\n");
+    text.flush ();
+    loaded.clear ();
+    t.notok (snapshot.load (text, loaded), "Snapshot: stale snapshot not loaded");
+    t.notok (snapshot.current (text), "Snapshot: stale snapshot not current");
+
+    // The appended file still starts with what the snapshot covers.
+    unsigned long long prefix = 0;
+    loaded.clear ();
+    t.ok (snapshot.load (text, loaded, NULL, &prefix) &&
+          prefix == saved, "Snapshot: appended file loaded as prefix");
+
+    // A rewritten file does not, even though it grew.
+    File::write ("./snapshot.data",
+                 "[description:\"uno\" entry:\"1234567890\" status:\"pending\" uuid:\"a\"]\n"
+                 "[annotation_1234567891:\"note\" description:\"two\" due:\"20150101\" status:\"pending\" uuid:\"b\"]\n"
+                 "[description:\"three\" status:\"pending\" uuid:\"c\"]\n");
+    loaded.clear ();
+    t.notok (snapshot.load (text, loaded, NULL, &prefix), "Snapshot: rewritten file not loaded as prefix");
+
+    // A corrupt snapshot is ignored.
+    File::write ("./snapshot.data.snapshot", "TWSNAP");
+    t.notok (snapshot.load (text, loaded), "Snapshot: corrupt snapshot not loaded");
+
+    unlink ("./snapshot.data");
+    snapshot.remove ();
+  }
+
+  catch (const std::string& error)
+  {
+    t.diag (error);
+    return -1;
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -34,7 +34,7 @@ Context context;
 ////////////////////////////////////////////////////////////////////////////////
 int main (int argc, char** argv)
 {
-  UnitTest test (23);
+  UnitTest test (35);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -62,6 +62,19 @@ int main (int argc, char** argv)
   after = t3.composeF4 ();
   test.is (before, after, "Task::composeF4 -> parse round trip 4 iterations");
 
+  // Encoding of special characters.
+  Task t4;
+  t4.set ("description", "a \"b\" [c] d/e\tf\ng");
+  t4.set ("empty", "");
+  test.is (t4.composeF4 (), "[description:\"a \\\"b\\\" &open;c&close; d\\/e\\tf\\ng\"]", "Task::composeF4 encodes special characters");
+  Task t5 (t4.composeF4 ());
+  test.is (t5.get ("description"), t4.get ("description"), "Task::composeF4 -> parse preserves special characters");
+
+  // Composition appends to a buffer.
+  std::string buffer = "x";
+  t3.composeF4 (buffer);
+  test.is (buffer, "x" + t3.composeF4 (), "Task::composeF4 appends to buffer");
+
   // Legacy Format 1 (no longer supported)
   //   [tags] [attributes] description\n
   //   X [tags] [attributes] description\n
@@ -151,6 +164,27 @@ TODO Task::decode
   left.set ("one", "1.0");
   test.notok (left == right, "left == right -> false");
 
+  // Attributes are kept in name order, however they arrive.
+  Task order ("[zeta:\"z\" alpha:\"a\" mu:\"m\"]");
+  order.set ("beta", "b");
+  test.is (order.composeF4 (), "[alpha:\"a\" beta:\"b\" mu:\"m\" zeta:\"z\"]", "Attributes ordered by name");
+  test.ok (order.erase ("mu") == 1 && ! order.has ("mu"), "Attributes::erase by name");
+  test.ok (order.erase ("mu") == 0, "Attributes::erase missing name");
+  test.ok (Attributes::intern ("alpha") == Attributes::intern (std::string ("alp") + "ha"), "Attributes::intern shares names");
+
+  // A parsed number is forgotten when the value changes.
+  Task cached ("[due:\"1000000000\"]");
+  test.is ((int) cached.get_date ("due"), 1000000000, "get_date parses");
+  cached.set ("due", "2000000000");
+  test.is ((int) cached.get_date ("due"), 2000000000, "get_date follows set");
+  cached["due"] = "1500000000";
+  test.is ((int) cached.get_date ("due"), 1500000000, "get_date follows operator[]");
+
+  // Task::getDateState
+  Task dated ("[due:\"1000000000\"]");
+  test.is ((int) dated.getDateState ("due"), (int) Task::dateBeforeToday, "getDateState past");
+  test.is ((int) dated.getDateState ("scheduled"), (int) Task::dateNotDue, "getDateState missing");
+
   // Task::validate
   Task bad ("[entry:1000000001 start:1000000000]");
   good = true;
@@ -36,7 +36,7 @@ Context context;
 ////////////////////////////////////////////////////////////////////////////////
 int main (int argc, char** argv)
 {
-  UnitTest t (12);
+  UnitTest t (30);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -55,6 +55,9 @@ int main (int argc, char** argv)
     context.config.set ("gc", "on");
     context.config.set ("debug", "on");
 
+    // Full undo records first, delta undo records below.
+    context.config.set ("undo.delta", "off");
+
     context.tdb2.set_location (".");
 
     // Try reading an empty database.
@@ -95,15 +98,122 @@ int main (int argc, char** argv)
     t.is ((int) undo.size (),      7, "TDB2 after add, 7 undo lines");
     t.is ((int) backlog.size (),   2, "TDB2 after add, 2 backlog task");
 
+    // Lookups by UUID and ID.
+    std::string uuid = task.get ("uuid");
+    Task found;
+    t.ok (context.tdb2.has (uuid),                    "TDB2 has task by UUID");
+    t.ok (context.tdb2.get (uuid, found) &&
+          found.get ("description") == "This is a test", "TDB2 get task by UUID");
+    t.ok (context.tdb2.get (task.id, found) &&
+          found.get ("uuid") == uuid,                 "TDB2 get task by ID");
+    t.is (context.tdb2.id (uuid), task.id,            "TDB2 id (uuid)");
+    t.is (context.tdb2.uuid (task.id), uuid,          "TDB2 uuid (id)");
+
     context.tdb2.commit ();
 
     // Reset for reuse.
     context.tdb2.clear ();
     context.tdb2.set_location (".");
 
-    // TODO commit
-    // TODO complete a task
-    // TODO gc
+    // A delta undo record holds only the changed attributes.
+    context.config.set ("undo.delta", "on");
+    task.set ("priority", "H");
+    context.tdb2.modify (task);
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    undo = context.tdb2.undo.get_lines ();
+    t.is ((int) undo.size (), 10, "TDB2 after delta modify, 10 undo lines");
+    t.ok (undo.size () > 8                  &&
+          undo[8].substr (0, 6) == "delta " &&
+          undo[8].find ("description") == std::string::npos, "TDB2 delta undo line omits unchanged attributes");
+
+    // Complete the task, and let gc move it to completed.data.
+    task.set ("status", "completed");
+    context.tdb2.modify (task);
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    context.tdb2.gc ();
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    t.is ((int) context.tdb2.pending.get_tasks ().size (),   0, "TDB2 after gc, 0 pending tasks");
+    t.is ((int) context.tdb2.completed.get_tasks ().size (), 1, "TDB2 after gc, 1 completed task");
+
+    // Reopen the task, and let gc move it back, cancelling the completed.data
+    // record with an appended tombstone.
+    context.config.set ("data.tombstones", "on");
+    task.set ("status", "pending");
+    context.tdb2.modify (task);
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    context.tdb2.gc ();
+    t.is ((int) context.tdb2.pending.get_tasks ().size (),   1, "TDB2 gc relocates to pending");
+    t.is ((int) context.tdb2.completed.get_tasks ().size (), 0, "TDB2 gc removes from completed");
+
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    t.is ((int) context.tdb2.completed.get_lines ().size (), 2, "TDB2 after gc, completed.data has a record and a tombstone");
+    t.is ((int) context.tdb2.completed.get_tasks ().size (), 0, "TDB2 after gc, tombstone cancels the record");
+
+    // Without tombstones, completed.data is rewritten instead.
+    context.config.set ("data.tombstones", "off");
+    task.set ("status", "completed");
+    context.tdb2.modify (task);
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+    context.tdb2.gc ();
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    task.set ("status", "pending");
+    context.tdb2.modify (task);
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+    context.tdb2.gc ();
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    t.is ((int) context.tdb2.completed.get_lines ().size (), 0, "TDB2 after gc without tombstones, completed.data is rewritten");
+
+    // A task attribute named like the tombstone keyword is just an attribute.
+    Task relocated ("[description:\"relocated\" status:\"completed\" relocated:\"x\"]");
+    context.tdb2.add (relocated);
+    context.tdb2.commit ();
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+
+    t.is ((int) context.tdb2.completed.get_tasks ().size (), 1, "TDB2 'relocated' attribute is not a tombstone");
+
+    // A task added as blocked by the reopened one.
+    Task blocked ("[description:\"blocked\" status:\"pending\"]");
+    blocked.set ("depends", uuid);
+    context.tdb2.add (blocked);
+
+    std::vector <Task> related;
+    context.tdb2.pending.get_blocked (uuid, related);
+    t.ok (related.size () == 1 && related[0].get ("description") == "blocked", "TDB2 get_blocked after add");
+
+    related.clear ();
+    context.tdb2.pending.get_blocking (blocked, related);
+    t.ok (related.size () == 1 && related[0].get ("uuid") == uuid, "TDB2 get_blocking after add");
+
+    const std::vector <unsigned int>& order = context.tdb2.pending.dependency_order ();
+    t.ok (order.size () == 2 && context.tdb2.pending.get_tasks ()[order[0]].get ("uuid") == uuid, "TDB2 dependency_order puts the blocking task first");
+
+    context.tdb2.commit ();
   }
 
   catch (const std::string& error)
@@ -0,0 +1,110 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+################################################################################
+##
+## Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+##
+## Permission is hereby granted, free of charge, to any person obtaining a copy
+## of this software and associated documentation files (the "Software"), to deal
+## in the Software without restriction, including without limitation the rights
+## to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+## copies of the Software, and to permit persons to whom the Software is
+## furnished to do so, subject to the following conditions:
+##
+## The above copyright notice and this permission notice shall be included
+## in all copies or substantial portions of the Software.
+##
+## THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+## OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+## FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+## THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+## LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+## OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+## SOFTWARE.
+##
+## http://www.opensource.org/licenses/mit-license.php
+##
+################################################################################
+
+import sys
+import os
+import time
+import unittest
+# Ensure python finds the local simpletap and basetest modules
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+
+from basetest import Task, TestCase
+
+
+class TestUndoSegments(TestCase):
+    def setUp(self):
+        """Executed before each test in the class"""
+        self.t = Task()
+        self.t.config("undo.segment.size", "1")
+
+        self.t(("add", "one"))
+        self.t(("1", "modify", "two"))
+
+    def segments(self):
+        return sorted(f for f in os.listdir(self.t.datadir)
+                      if f.startswith("undo.") and f != "undo.data" and
+                      not f.startswith("undo.data."))
+
+    def test_rotation(self):
+        """undo.data is moved aside once it exceeds the segment size"""
+        self.assertEqual(self.segments(), ["undo.1.data", "undo.2.data"])
+        self.assertFalse(os.path.exists(os.path.join(self.t.datadir, "undo.data")))
+
+    def test_undo_restores_segments(self):
+        """Undo brings back the latest segment once undo.data is empty"""
+        code, out, err = self.t(("undo",))
+        self.assertIn("Modified task reverted", out)
+        self.assertEqual(self.segments(), ["undo.1.data"])
+
+        code, out, err = self.t(("_get", "1.description"))
+        self.assertEqual(out, "one\n")
+
+        code, out, err = self.t(("undo",))
+        self.assertIn("Task removed", out)
+        self.assertEqual(self.segments(), [])
+
+        code, out, err = self.t.runError(("undo",))
+        self.assertIn("There are no recorded transactions to undo", err)
+
+    def test_compression(self):
+        """Segments are compressed, and restored from compressed form"""
+        self.t.config("undo.compress", "on")
+        self.t(("1", "modify", "three"))
+        self.assertEqual(self.segments(),
+                         ["undo.1.data.gz", "undo.2.data.gz", "undo.3.data.gz"])
+
+        self.t(("undo",))
+        code, out, err = self.t(("_get", "1.description"))
+        self.assertEqual(out, "two\n")
+        self.assertEqual(self.segments(), ["undo.1.data.gz", "undo.2.data.gz"])
+
+    def test_retention(self):
+        """Segments older than the retention period are deleted"""
+        old = time.time() - 3 * 86400
+        os.utime(os.path.join(self.t.datadir, "undo.1.data"), (old, old))
+
+        self.t.config("undo.retention", "2")
+        self.t(("1", "modify", "three"))
+        self.assertEqual(self.segments(), ["undo.2.data", "undo.3.data"])
+
+    def test_stats(self):
+        """Stats counts the undo transactions in every segment"""
+        code, out, err = self.t(("stats",))
+        self.assertRegexpMatches(out, "Undo transactions\s+2\n")
+
+        self.t.config("undo.compress", "on")
+        self.t(("1", "modify", "three"))
+        code, out, err = self.t(("stats",))
+        self.assertRegexpMatches(out, "Undo transactions\s+3\n")
+
+
+if __name__ == "__main__":
+    from simpletap import TAPTestRunner
+    unittest.main(testRunner=TAPTestRunner())
+
+# vim: ai sts=4 et sw=4
@@ -27,7 +27,7 @@
 
 use strict;
 use warnings;
-use Test::More tests => 19;
+use Test::More tests => 26;
 
 # Ensure environment has no influence.
 delete $ENV{'TASKDATA'};
@@ -98,6 +98,39 @@ else
   fail ("$ut: [3] completed");
 }
 
+# Undo seeks to the last transaction by way of the undo.data index, which must
+# follow the transactions added since it was saved.
+qx{../src/task rc:$rc add three 2>&1; ../src/task rc:$rc 1 modify four 2>&1; ../src/task rc:$rc undo 2>&1};
+$output = qx{../src/task rc:$rc 1 modify five 2>&1; ../src/task rc:$rc 1 modify six 2>&1; ../src/task rc:$rc undo 2>&1; ../src/task rc:$rc _get 1.description 2>&1};
+like ($output, qr/^five$/ms, "$ut: Undo after transactions appended to the index");
+
+$output = qx{../src/task rc:$rc undo 2>&1; ../src/task rc:$rc _get 1.description 2>&1};
+like ($output, qr/^three$/ms, "$ut: Undo back to the original");
+
+# Info shows the history of one task from the index.
+$output = qx{../src/task rc:$rc add eight 2>&1; ../src/task rc:$rc 1 modify seven 2>&1; ../src/task rc:$rc info 1 2>&1};
+like ($output, qr/Description changed from 'three' to 'seven'/, "$ut: Info shows the modification");
+unlike ($output, qr/eight/, "$ut: Info shows only the task's own history");
+
+# Modifications are recorded as deltas of the changed attributes only.
+qx{../src/task rc:$rc 1 annotate note 2>&1};
+if (open my $fh, '<', 'undo.data')
+{
+  my @lines = <$fh>;
+  close $fh;
+
+  like ($lines[-2], qr/^delta \[annotation_\d+:"note" .*uuid:"[^"]+"\] \[.*uuid:"[^"]+"\]$/, "$ut: Annotation recorded as a delta");
+  unlike ($lines[-2], qr/description/, "$ut: Delta omits unchanged attributes");
+}
+else
+{
+  fail ("$ut: Annotation recorded as a delta");
+  fail ("$ut: Delta omits unchanged attributes");
+}
+
+$output = qx{../src/task rc:$rc undo 2>&1 >/dev/null; ../src/task rc:$rc info 1 2>&1};
+unlike ($output, qr/note/, "$ut: Delta reverted");
+
 # Cleanup.
-unlink qw(pending.data completed.data undo.data backlog.data), $rc;
+unlink qw(pending.data pending.data.snapshot completed.data completed.data.snapshot completed.data.index undo.data undo.data.index backlog.data), $rc;
 exit 0;
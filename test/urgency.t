@@ -27,7 +27,7 @@
 
 use strict;
 use warnings;
-use Test::More tests => 47;
+use Test::More tests => 49;
 
 # Ensure environment has no influence.
 delete $ENV{'TASKDATA'};
@@ -333,6 +333,19 @@ qx {../src/task rc:$rc add 13 pri:H 2>&1};
 $output = qx{../src/task rc:$rc rc.urgency.priority.coefficient:0.01234 46 info 2>&1};
 like ($output, qr/Urgency\s+0\.01$/ms, "$ut: near-zero urgency is truncated");
 
+# inherit: 10 (blocking) + 1 (14b pri:H) + 0.65 (14c pri:M, blocked by 14b)
+qx {../src/task rc:$rc add 14a 2>&1};                       # task 47
+qx {../src/task rc:$rc add 14b pri:H depends:47 2>&1};      # task 48
+qx {../src/task rc:$rc add 14c pri:M depends:48 2>&1};      # task 49
+$output = qx{../src/task rc:$rc rc.urgency.inherit.coefficient:1 47 _urgency 2>&1};
+($value) = $output =~ /urgency\s([0-9.]+)/;
+in_range ($value, 11.6, 11.7, "$ut: inherited along the chain = 11.65");
+
+# user.project: 10 (pro:PROJECT.sub) + 10 (project)
+qx{../src/task rc:$rc add 15a project:PROJECT.sub 2>&1};    # task 50
+$output = qx{../src/task rc:$rc 50 _urgency 2>&1};
+like ($output, qr/urgency 20$/ms, "$ut: pro:PROJECT.sub = 20");
+
 # Cleanup.
 unlink qw(pending.data completed.data undo.data backlog.data), $rc;
 exit 0;